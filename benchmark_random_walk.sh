@@ -0,0 +1,73 @@
+#!/bin/bash
+# Compare the two ways of producing random walks on the bundled data/rdf
+# files: the SPARQL path (one ORDER BY RAND() query per hop against Fuseki,
+# as random_walk.sh used to do) and the in-process C++ walker. Both write
+# "DATE RANDOM WALK (length=N): a -> b -> ..." lines with lengths from 8 to 15.
+#
+# The SPARQL path needs Fuseki: set FUSEKI_HOME to start one on GRAPH_FILE,
+# or FUSEKI_URL to use a running one. Without either only the walker runs.
+#   FUSEKI_HOME=/path/to/apache-jena-fuseki-5.3.0 ./benchmark_random_walk.sh
+
+WALKER=${WALKER:-./data_loading/random_walker}
+GRAPH_FILE=${GRAPH_FILE:-data/rdf/random_triples.ttl}
+SPARQL_WALKS=${SPARQL_WALKS:-100}
+NUM_WORKERS=${NUM_WORKERS:-$(nproc)}
+OUT_DIR=${OUT_DIR:-$(mktemp -d)}
+
+function run_sparql_query() {
+    curl -s -X POST "${FUSEKI_URL}" --data-urlencode "query=$1" -H "Accept: text/tab-separated-values"
+}
+
+# Same walk as the original random_walk.sh, with IRIs unwrapped from the
+# TSV angle brackets before they are put back into the next query
+function sparql_random_walk() {
+    local WALK_LENGTH=$(( RANDOM % 8 + 8 ))
+    local current_node=$( run_sparql_query "SELECT ?s WHERE { ?s ?p ?o } ORDER BY RAND() LIMIT 1" | tail -n +2 | head -n1 )
+    [[ -z "${current_node}" ]] && return
+    local walk="${current_node}"
+    for (( i=1; i < WALK_LENGTH; i++ )); do
+        [[ "${current_node}" != \<* ]] && break   # literals have no out-edges
+        local next_node=$( run_sparql_query "SELECT ?next WHERE { ${current_node} ?p ?next } ORDER BY RAND() LIMIT 1" | tail -n +2 | head -n1 )
+        [[ -z "${next_node}" ]] && break
+        walk+=" -> ${next_node}"
+        current_node=${next_node}
+    done
+    echo "$(date +'%Y-%m-%dT%H:%M:%S') RANDOM WALK (length=${WALK_LENGTH}): ${walk}"
+}
+
+# Walks per second from a start time in nanoseconds and a walk count
+function rate() {
+    local elapsed=$(( $(date +%s%N) - $1 ))
+    awk -v n="$2" -v ns="${elapsed}" 'BEGIN { printf "%d walks in %.3f s (%.1f walks/sec)", n, ns / 1e9, n / (ns / 1e9) }'
+}
+
+echo "Graph: ${GRAPH_FILE} | Threads: ${NUM_WORKERS} | Output: ${OUT_DIR}"
+
+start=$(date +%s%N)
+${WALKER} -f "${GRAPH_FILE}" -o "${OUT_DIR}/walker.out" --format text --min-length 8 -l 15 -w 10 \
+    -t ${NUM_WORKERS} --seed 42 2> "${OUT_DIR}/walker.log" || { cat "${OUT_DIR}/walker.log"; exit 1; }
+echo "C++ walker: $(rate ${start} $(wc -l < "${OUT_DIR}/walker.out")) (load included)"
+grep "Performance" "${OUT_DIR}/walker.log" | sed 's/^\[[^]]*\] /C++ walker, walks only: /'
+
+FUSEKI_PID=""
+if [[ -z "${FUSEKI_URL}" && -n "${FUSEKI_HOME}" ]]; then
+    ${FUSEKI_HOME}/fuseki-server --file="${GRAPH_FILE}" --port=3031 /bench > "${OUT_DIR}/fuseki.log" 2>&1 &
+    FUSEKI_PID=$!
+    FUSEKI_URL="http://localhost:3031/bench/sparql"
+    sleep 10
+fi
+if [[ -z "${FUSEKI_URL}" ]]; then
+    echo "SPARQL path skipped: set FUSEKI_HOME or FUSEKI_URL"
+    exit 0
+fi
+
+export FUSEKI_URL
+export -f run_sparql_query sparql_random_walk
+start=$(date +%s%N)
+seq ${SPARQL_WALKS} | xargs -P ${NUM_WORKERS} -I{} bash -c sparql_random_walk > "${OUT_DIR}/sparql.out"
+echo "SPARQL/curl: $(rate ${start} $(wc -l < "${OUT_DIR}/sparql.out"))"
+
+if [[ -n "${FUSEKI_PID}" ]]; then
+    kill ${FUSEKI_PID}
+    wait ${FUSEKI_PID} 2>/dev/null
+fi
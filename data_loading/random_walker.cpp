@@ -8,6 +8,7 @@
 #include <ctime>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <chrono>
 #include <iomanip>
 #include <atomic>
@@ -18,31 +19,600 @@
 // Add socket programming headers
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
 #include <unistd.h>
-#include <set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cstdlib>
+#include <memory>
+#include <deque>
+#include <map>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <cstdint>
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
 
-// Replace the existing Graph definition with this enhanced version
+// Every IRI, blank node and literal is interned into a dense uint32 ID.
+// Subjects, predicates and objects share one ID space so that a walk is
+// simply a sequence of IDs and is only turned back into strings on output.
+using NodeId = uint32_t;
+using Walk = std::vector<NodeId>;
+
+const NodeId kInvalidNode = std::numeric_limits<NodeId>::max();
+
+// Packed (predicate, target) pair stored in the CSR edge array
 struct Edge {
-    std::string predicate;
-    std::string target;
+    NodeId predicate;
+    NodeId target;
+};
+
+struct Triple {
+    NodeId subject;
+    NodeId predicate;
+    NodeId object;
+};
+
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Fast non-cryptographic 64-bit hash, stable across runs so it can be used for
+// the snapshot index and checksums
+inline uint64_t hashBytes(const char* data, size_t length, uint64_t seed = 0) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = seed ^ (length * multiplier);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ mix64(word)) * multiplier;
+    }
+    uint64_t tail = 0;
+    if (i < length)     // data may be null for an empty term
+        memcpy(&tail, data + i, length - i);
+    h = (h ^ mix64(tail)) * multiplier;
+    return mix64(h);
+}
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char* mapped = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (mapped)
+            munmap(const_cast<char*>(mapped), length);
+    }
+
+    bool open(const std::string& filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            mapped = static_cast<const char*>(addr);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void adviseSequential() const {
+        if (mapped)
+            madvise(const_cast<char*>(mapped), length, MADV_SEQUENTIAL);
+    }
+
+    const char* data() const { return mapped; }
+    size_t size() const { return length; }
+};
+
+// Array that either owns its elements or points into a mapped snapshot. Only
+// owned arrays can grow.
+template <typename T>
+class FlatArray {
+private:
+    std::vector<T> owned;
+    const T* ptr = nullptr;
+    size_t count = 0;
+
+    void sync() {
+        ptr = owned.data();
+        count = owned.size();
+    }
+
+public:
+    FlatArray() = default;
+    FlatArray(FlatArray&&) = default;
+    FlatArray& operator=(FlatArray&&) = default;
+    FlatArray(const FlatArray&) = delete;
+    FlatArray& operator=(const FlatArray&) = delete;
+
+    void assign(std::vector<T>&& values) {
+        owned = std::move(values);
+        sync();
+    }
+
+    void push_back(const T& value) {
+        owned.push_back(value);
+        sync();
+    }
+
+    void append(const T* values, size_t n) {
+        owned.insert(owned.end(), values, values + n);
+        sync();
+    }
+
+    void set(size_t i, const T& value) { owned[i] = value; }
+
+    void mapFrom(const T* data, size_t n) {
+        owned = std::vector<T>();
+        ptr = data;
+        count = n;
+    }
+
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T* data() const { return ptr; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t bytes() const { return count * sizeof(T); }
+};
+
+struct Graph;
+
+// A term as it is stored: a namespace prefix, the term's own text and a
+// namespace suffix. Writers copy the three pieces straight into their output,
+// so emitting a term never builds a string.
+struct TermParts {
+    std::string_view prefix;
+    std::string_view local;
+    std::string_view suffix;
+
+    size_t size() const { return prefix.size() + local.size() + suffix.size(); }
+
+    char* copyTo(char* p) const {
+        memcpy(p, prefix.data(), prefix.size());
+        p += prefix.size();
+        memcpy(p, local.data(), local.size());
+        p += local.size();
+        memcpy(p, suffix.data(), suffix.size());
+        return p + suffix.size();
+    }
+
+    void appendTo(std::string& out) const {
+        out.append(prefix);
+        out.append(local);
+        out.append(suffix);
+    }
+
+    std::string str() const {
+        std::string out;
+        out.reserve(size());
+        appendTo(out);
+        return out;
+    }
+
+    bool operator==(std::string_view term) const {
+        return term.size() == size() && term.compare(0, prefix.size(), prefix) == 0 &&
+               term.compare(prefix.size(), local.size(), local) == 0 &&
+               term.compare(prefix.size() + local.size(), suffix.size(), suffix) == 0;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const TermParts& term) {
+    return out << term.prefix << term.local << term.suffix;
+}
+
+// Split a term into namespace affixes and local text: an IRI at its last '/'
+// or '#' (<http://dbpedia.org/resource/ + Berlin + >), a literal at its quotes
+// ("  + 1987 + "^^<http://www.w3.org/2001/XMLSchema#gYear>), a blank node or
+// pg: term after its colon. `cut` picks an earlier separator of an IRI, for
+// when the namespace table is full.
+inline bool splitTerm(std::string_view term, std::string_view& prefix, std::string_view& suffix, int cut = 0) {
+    size_t end;
+    if (term.size() >= 2 && term.front() == '<' && term.back() == '>') {
+        end = term.size() - 1;
+        suffix = term.substr(end);
+        for (int i = 0; i <= cut; i++) {
+            end = term.find_last_of("/#", end - 1);
+            if (end == std::string_view::npos || end == 0)
+                return false;
+        }
+        prefix = term.substr(0, end + 1);
+        return true;
+    }
+    if (cut > 0)
+        return false;
+    if (term.size() >= 2 && term.front() == '"' && (end = term.rfind('"')) > 0) {
+        prefix = term.substr(0, 1);
+        suffix = term.substr(end);
+        return true;
+    }
+    if (term.compare(0, 2, "_:") == 0 || term.compare(0, 3, "pg:") == 0) {
+        prefix = term.substr(0, term.find(':') + 1);
+        suffix = std::string_view();
+        return true;
+    }
+    return false;
+}
+
+// Well-known namespaces for --curies output, as in DBpedia's @prefix lines
+const std::pair<const char*, const char*> kCuriePrefixes[] = {
+    {"<http://dbpedia.org/resource/", "dbr:"},
+    {"<http://dbpedia.org/ontology/", "dbo:"},
+    {"<http://dbpedia.org/property/", "dbp:"},
+    {"<http://www.w3.org/1999/02/22-rdf-syntax-ns#", "rdf:"},
+    {"<http://www.w3.org/2000/01/rdf-schema#", "rdfs:"},
+    {"<http://www.w3.org/2002/07/owl#", "owl:"},
+    {"<http://www.w3.org/2001/XMLSchema#", "xsd:"},
+    {"<http://www.w3.org/2004/02/skos/core#", "skos:"},
+    {"<http://xmlns.com/foaf/0.1/", "foaf:"},
+    {"<http://purl.org/dc/terms/", "dct:"},
+    {"<http://purl.org/dc/elements/1.1/", "dc:"},
+    {"<http://www.wikidata.org/entity/", "wd:"},
+    {"<http://schema.org/", "schema:"},
+    {"<http://www.w3.org/ns/prov#", "prov:"},
+    {"<http://www.opengis.net/ont/geosparql#", "geo:"},
 };
 
-using Graph = std::unordered_map<std::string, std::vector<Edge>>;
+// Term dictionary: every term is a namespace (a prefix and suffix pair kept
+// once in a small table) plus its own text, and the text of all terms is
+// appended back to back in one arena buffer. The offset where a term's text
+// ends carries its namespace in the top 16 bits, so ID -> term is two reads.
+// String -> ID lookups hash the full term and go through an open-addressing
+// table of IDs. All of it is plain arrays, so a dictionary can be written to
+// a snapshot and used from the mapping without rebuilding anything.
+class Dictionary {
+private:
+    static const int kNamespaceShift = 48;
+    static const uint64_t kTextMask = (1ULL << kNamespaceShift) - 1;
+    static const size_t kMaxNamespaces = 1 << (64 - kNamespaceShift);
+
+    FlatArray<char> text;
+    FlatArray<uint64_t> textOffsets;        // size() + 1 entries; entry id + 1 is namespace << 48 | end of term id
+    FlatArray<NodeId> slots;                // power-of-two table, kInvalidNode marks a free slot
+    FlatArray<char> namespaceText;
+    FlatArray<uint32_t> namespaceOffsets;   // prefix i is [2i, 2i + 1), suffix i is [2i + 1, 2i + 2)
+
+    // Only needed to intern: (prefix, suffix) -> namespace, and --curies names
+    std::unordered_map<std::string, uint16_t> namespaceIds;
+    std::string namespaceKey;
+    std::vector<std::string> curieNames;
+    bool curies = false;
+
+    static uint64_t hashTerm(std::string_view term) { return hashBytes(term.data(), term.size()); }
+
+    std::string_view namespacePart(size_t i) const {
+        return std::string_view(namespaceText.data() + namespaceOffsets[i], namespaceOffsets[i + 1] - namespaceOffsets[i]);
+    }
+
+    // Namespace of a new term; namespace 0 (no affixes) when none fits
+    uint16_t namespaceOf(std::string_view term) {
+        std::string_view prefix, suffix;
+        for (int cut = 0; splitTerm(term, prefix, suffix, cut); cut++) {
+            namespaceKey.assign(prefix);
+            namespaceKey.push_back('\0');
+            namespaceKey.append(suffix);
+            auto it = namespaceIds.find(namespaceKey);
+            if (it != namespaceIds.end())
+                return it->second;
+            if (numNamespaces() < kMaxNamespaces) {
+                uint16_t ns = static_cast<uint16_t>(numNamespaces());
+                namespaceText.append(prefix.data(), prefix.size());
+                namespaceOffsets.push_back(static_cast<uint32_t>(namespaceText.size()));
+                namespaceText.append(suffix.data(), suffix.size());
+                namespaceOffsets.push_back(static_cast<uint32_t>(namespaceText.size()));
+                namespaceIds.emplace(namespaceKey, ns);
+                if (curies)
+                    curieNames.push_back(curieName(ns));
+                return ns;
+            }
+        }
+        return 0;
+    }
+
+    std::string curieName(size_t ns) const {
+        if (namespacePart(2 * ns + 1) != ">")
+            return std::string();
+        for (const auto& known : kCuriePrefixes) {
+            if (namespacePart(2 * ns) == known.first)
+                return known.second;
+        }
+        return std::string();
+    }
+
+    void rehash(size_t numSlots) {
+        std::vector<NodeId> table(numSlots, kInvalidNode);
+        size_t mask = numSlots - 1;
+        std::string term;
+        for (NodeId id = 0; id < size(); id++) {
+            term.clear();
+            name(id).appendTo(term);
+            size_t slot = hashTerm(term) & mask;
+            while (table[slot] != kInvalidNode)
+                slot = (slot + 1) & mask;
+            table[slot] = id;
+        }
+        slots.assign(std::move(table));
+    }
+
+public:
+    friend bool saveGraphSnapshot(const Graph& graph, const std::string& filename);
+    friend Graph loadGraphSnapshot(const std::string& filename);
+
+    Dictionary() {
+        textOffsets.push_back(0);
+        namespaceOffsets.assign({0, 0, 0});
+        namespaceIds.emplace(std::string(1, '\0'), 0);
+    }
+
+    // Owned copy that can take new terms, e.g. of a dictionary mapped from a snapshot
+    Dictionary clone() const {
+        Dictionary copy;
+        copy.text.assign(std::vector<char>(text.begin(), text.end()));
+        copy.textOffsets.assign(std::vector<uint64_t>(textOffsets.begin(), textOffsets.end()));
+        copy.slots.assign(std::vector<NodeId>(slots.begin(), slots.end()));
+        copy.namespaceText.assign(std::vector<char>(namespaceText.begin(), namespaceText.end()));
+        copy.namespaceOffsets.assign(std::vector<uint32_t>(namespaceOffsets.begin(), namespaceOffsets.end()));
+        copy.namespaceIds.clear();
+        for (size_t ns = 0; ns < numNamespaces(); ns++) {
+            std::string key(namespacePart(2 * ns));
+            key.push_back('\0');
+            key.append(namespacePart(2 * ns + 1));
+            copy.namespaceIds.emplace(std::move(key), static_cast<uint16_t>(ns));
+        }
+        copy.useCuries(curies);
+        return copy;
+    }
+
+    NodeId intern(std::string_view term) {
+        if ((size() + 1) * 10 > slots.size() * 7)
+            rehash(std::max<size_t>(1024, slots.size() * 2));
+
+        size_t mask = slots.size() - 1;
+        size_t slot = hashTerm(term) & mask;
+        for (NodeId id; (id = slots[slot]) != kInvalidNode; slot = (slot + 1) & mask) {
+            if (name(id) == term)
+                return id;
+        }
+
+        NodeId id = static_cast<NodeId>(size());
+        uint16_t ns = namespaceOf(term);
+        std::string_view prefix = namespacePart(2 * ns), suffix = namespacePart(2 * ns + 1);
+        std::string_view local = term.substr(prefix.size(), term.size() - prefix.size() - suffix.size());
+        text.append(local.data(), local.size());
+        textOffsets.push_back(static_cast<uint64_t>(ns) << kNamespaceShift | text.size());
+        slots.set(slot, id);
+        return id;
+    }
+
+    NodeId find(std::string_view term) const {
+        if (slots.empty())
+            return kInvalidNode;
+        size_t mask = slots.size() - 1;
+        size_t slot = hashTerm(term) & mask;
+        for (NodeId id; (id = slots[slot]) != kInvalidNode; slot = (slot + 1) & mask) {
+            if (name(id) == term)
+                return id;
+        }
+        return kInvalidNode;
+    }
+
+    // The full term, e.g. <http://dbpedia.org/resource/Berlin>
+    TermParts name(NodeId id) const {
+        uint64_t begin = textOffsets[id] & kTextMask;
+        uint64_t end = textOffsets[id + 1];
+        size_t ns = end >> kNamespaceShift;
+        end &= kTextMask;
+        return {namespacePart(2 * ns), std::string_view(text.data() + begin, end - begin), namespacePart(2 * ns + 1)};
+    }
+
+    // The term as walks are written: dbr:Berlin when --curies is on and the
+    // namespace is a well-known one, the full term otherwise
+    TermParts outputName(NodeId id) const {
+        if (curies) {
+            size_t ns = textOffsets[id + 1] >> kNamespaceShift;
+            if (!curieNames[ns].empty()) {
+                uint64_t begin = textOffsets[id] & kTextMask;
+                uint64_t end = textOffsets[id + 1] & kTextMask;
+                return {curieNames[ns], std::string_view(text.data() + begin, end - begin), std::string_view()};
+            }
+        }
+        return name(id);
+    }
+
+    void useCuries(bool enable) {
+        curies = enable;
+        curieNames.clear();
+        for (size_t ns = 0; enable && ns < numNamespaces(); ns++)
+            curieNames.push_back(curieName(ns));
+    }
+
+    size_t size() const { return textOffsets.size() - 1; }
+
+    size_t numNamespaces() const { return namespaceOffsets.size() / 2; }
+
+    size_t textBytes() const { return text.bytes() + namespaceText.bytes(); }
+
+    size_t memoryUsage() const {
+        return text.bytes() + textOffsets.bytes() + slots.bytes() + namespaceText.bytes() + namespaceOffsets.bytes();
+    }
+};
+
+// Compressed-sparse-row adjacency: the out-edges of node n are
+// edges[offsets[n] .. offsets[n + 1]).
+struct Graph {
+    Dictionary dict;
+    FlatArray<uint64_t> offsets;
+    FlatArray<Edge> edges;
+    std::shared_ptr<MappedFile> snapshot;  // backing storage when loaded from a snapshot
+    
+    // Optional alias tables for weighted sampling, aligned with edges: slot i
+    // of a node is kept if a 32-bit draw is below aliasThreshold, otherwise
+    // aliasIndex names the edge to take (kNoEdge if the node has no weight)
+    FlatArray<uint32_t> aliasThreshold;
+    FlatArray<uint32_t> aliasIndex;
+
+    size_t numNodes() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t numEdges() const { return edges.size(); }
+    bool empty() const { return edges.empty(); }
+
+    size_t degree(NodeId node) const { return offsets[node + 1] - offsets[node]; }
+    const Edge* edgesOf(NodeId node) const { return edges.data() + offsets[node]; }
+
+    bool weighted() const { return !aliasIndex.empty(); }
+
+    size_t memoryUsage() const {
+        return dict.memoryUsage() + offsets.bytes() + edges.bytes() + aliasThreshold.bytes() + aliasIndex.bytes();
+    }
+};
+
+const uint32_t kNoEdge = std::numeric_limits<uint32_t>::max();
+
+// Shard that owns a node's out-edges when the graph is split across processes
+inline int shardOf(NodeId node, int numShards) {
+    return static_cast<int>(mix64(node) % static_cast<uint64_t>(numShards));
+}
+
+inline bool operator<(const Edge& a, const Edge& b) {
+    return a.target != b.target ? a.target < b.target : a.predicate < b.predicate;
+}
+
+// Counting sort of the triples by subject into the CSR arrays, then sort the
+// edges of every node by target so hasEdgeTo can binary search them
+void buildAdjacency(Graph& graph, const std::vector<std::vector<Triple>>& parts, int numThreads = 1) {
+    size_t numNodes = graph.dict.size();
+    size_t numTriples = 0;
+    std::vector<uint64_t> offsets(numNodes + 1, 0);
+    for (const auto& triples : parts) {
+        numTriples += triples.size();
+        for (const auto& t : triples)
+            offsets[t.subject + 1]++;
+    }
+    for (size_t i = 0; i < numNodes; i++)
+        offsets[i + 1] += offsets[i];
+
+    std::vector<Edge> edges(numTriples);
+    std::vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (const auto& triples : parts) {
+        for (const auto& t : triples)
+            edges[cursor[t.subject]++] = {t.predicate, t.object};
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t node = numNodes * t / numThreads; node < numNodes * (t + 1) / numThreads; node++)
+                std::sort(edges.begin() + offsets[node], edges.begin() + offsets[node + 1]);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    graph.offsets.assign(std::move(offsets));
+    graph.edges.assign(std::move(edges));
+}
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Scan one N-Triples term starting at p. The term is returned as a view into
+// the input with its delimiters kept: <IRI>, _:blank, "literal"@lang or
+// "literal"^^<type>. Quoted literals may contain spaces and escaped quotes.
+bool scanTerm(const char*& p, const char* end, std::string_view& term) {
+    while (p < end && isBlank(*p))
+        p++;
+    if (p >= end)
+        return false;
+
+    const char* start = p;
+    if (*p == '<') {
+        const char* close = static_cast<const char*>(memchr(p, '>', end - p));
+        if (!close)
+            return false;
+        p = close + 1;
+    } else if (*p == '"') {
+        p++;
+        while (p < end && *p != '"')
+            p += (*p == '\\') ? 2 : 1;
+        if (p >= end)
+            return false;
+        p++;
+        if (p < end && *p == '@') {
+            p++;
+            while (p < end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '-'))
+                p++;
+        } else if (p + 1 < end && p[0] == '^' && p[1] == '^') {
+            p += 2;
+            if (p < end && *p == '<') {
+                const char* close = static_cast<const char*>(memchr(p, '>', end - p));
+                if (!close)
+                    return false;
+                p = close + 1;
+            } else {
+                while (p < end && !isBlank(*p))
+                    p++;
+            }
+        }
+    } else {
+        while (p < end && !isBlank(*p))
+            p++;
+    }
+    term = std::string_view(start, p - start);
+    return true;
+}
 
-bool parseTriple(const std::string& line, std::string& subject, std::string& predicate, std::string& object) {
-    std::istringstream iss(line);
-    if (!(iss >> subject >> predicate >> object))
+// Parse the subject, predicate and object of an N-Triples line. N-Quads lines
+// (e.g. a tdb2.tdbdump of a TDB2 store) parse too: the graph label after the
+// object is ignored, so every named graph is merged into one.
+bool parseTriple(std::string_view line, std::string_view& subject, std::string_view& predicate, std::string_view& object) {
+    const char* p = line.data();
+    const char* end = p + line.size();
+    if (!scanTerm(p, end, subject) || !scanTerm(p, end, predicate) || !scanTerm(p, end, object))
         return false;
-    if (!object.empty() && object.back() == '.')
-        object.pop_back();
+    // A bare object token may carry the statement terminator ("obj.")
+    if (object.size() > 1 && object.back() == '.' && object.front() != '<' && object.front() != '"')
+        object.remove_suffix(1);
     return true;
 }
 
 std::string getCurrentTimestamp() {
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
+    struct tm local;
+    localtime_r(&time, &local);   // logging happens on many threads at once
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
@@ -62,637 +632,4822 @@ std::string formatDuration(std::chrono::duration<double> duration) {
     }
 }
 
-Graph loadGraph(const std::string& filename) {
-    Graph graph;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::clog << "[" << getCurrentTimestamp() << "] Error opening file: " << filename << "\n";
-        return graph;
+std::string formatBytes(size_t bytes) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        unit++;
     }
-    std::clog << "[" << getCurrentTimestamp() << "] Parsing file: " << filename << "\n";
-    
-    auto startTime = std::chrono::high_resolution_clock::now();
-    
-    std::string line;
-    int count = 0, lineNum = 0;
-    while (std::getline(file, line)) {
-        lineNum++;
-        if (line.empty() || line[0] == '#')
-            continue;
-        std::string subject, predicate, object;
-        if (parseTriple(line, subject, predicate, object)) {
-            // Store predicate and object
-            graph[subject].push_back({predicate, object});
-            count++;
-        } else {
-            std::clog << "[" << getCurrentTimestamp() << "] Failed to parse line " << lineNum << ": " << line << "\n";
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << value << " " << units[unit];
+    return ss.str();
+}
+
+// Instrumentation. Every thread counts into its own ThreadMetrics block, so
+// recording is a plain load and store on memory no other thread writes; a
+// reader sums the blocks with relaxed loads, without stopping anyone.
+// Latencies go into log-linear histograms (each power of two split into 16
+// buckets, so quantiles are within about 6%). Everything is off unless
+// --metrics or --metrics-port is given; hot loops then time only one walk in
+// kMetricsSampleEvery.
+enum MetricPhase {
+    kPhaseParse,        // one chunk of an input file
+    kPhaseIntern,       // merging one chunk's terms into the dictionary
+    kPhaseStep,         // one walk step (walk time / steps, sampled)
+    kPhaseDedup,        // distinct walks from one start node (server)
+    kPhaseSerialize,    // formatting one walk (sampled), or one start node's walks (server)
+    kPhaseWrite,        // one write() of an output chunk or one socket frame
+    kPhaseRequest,      // one server request, from accept to reply
+    kNumPhases
+};
+
+const char* const kPhaseNames[kNumPhases] = {"parse", "intern", "sample_step", "dedup", "serialize", "write", "request"};
+
+enum MetricCounter {
+    kCounterLines,
+    kCounterTriples,
+    kCounterWalks,
+    kCounterSteps,
+    kCounterDuplicates,
+    kCounterBytesWritten,
+    kCounterRequests,
+    kNumCounters
+};
+
+const char* const kCounterNames[kNumCounters] = {"lines_parsed", "triples_parsed", "walks", "walk_steps", 
+                                                 "duplicate_walks", "bytes_written", "requests"};
+
+const uint64_t kMetricsSampleEvery = 64;
+bool gMetricsEnabled = false;   // set once in main, before any thread starts
+
+inline uint64_t metricsClock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LatencyHistogram {
+public:
+    static const int kSubBits = 4;
+    static const int kNumBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    static int bucketOf(uint64_t value) {
+        if (value < (1ULL << kSubBits))
+            return static_cast<int>(value);
+        int exponent = 63 - __builtin_clzll(value);
+        int shift = exponent - kSubBits;
+        return ((shift + 1) << kSubBits) + static_cast<int>((value >> shift) & ((1ULL << kSubBits) - 1));
+    }
+
+    // Largest value that falls into bucket
+    static uint64_t bucketLimit(int bucket) {
+        if (bucket < (1 << kSubBits))
+            return bucket;
+        int shift = (bucket >> kSubBits) - 1;
+        uint64_t mantissa = (1ULL << kSubBits) | (bucket & ((1 << kSubBits) - 1));
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    std::atomic<uint64_t> counts[kNumBuckets] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    // Single writer: only the owning thread records
+    void record(uint64_t value) {
+        auto bump = [](std::atomic<uint64_t>& counter, uint64_t n) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        };
+        bump(counts[bucketOf(value)], 1);
+        bump(total, 1);
+        bump(sum, value);
+        if (value > max.load(std::memory_order_relaxed))
+            max.store(value, std::memory_order_relaxed);
+    }
+};
+
+struct ThreadMetrics {
+    std::atomic<uint64_t> counters[kNumCounters] = {};
+    LatencyHistogram phases[kNumPhases];
+
+    void add(MetricCounter counter, uint64_t n) {
+        counters[counter].store(counters[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void record(MetricPhase phase, uint64_t nanoseconds) { phases[phase].record(nanoseconds); }
+};
+
+// Blocks are never freed: a thread that exits hands its block to the next
+// thread that starts, so totals keep counting and readers can always walk
+// the whole table
+class MetricsRegistry {
+private:
+    static const int kMaxBlocks = 1024;
+    std::atomic<ThreadMetrics*> blocks[kMaxBlocks] = {};
+    std::atomic<int> numBlocks{0};
+    std::mutex freeMutex;               // only taken when a thread starts or exits
+    std::vector<ThreadMetrics*> freeBlocks;
+    ThreadMetrics overflow;             // shared by threads beyond kMaxBlocks; counts may be lost there
+
+public:
+    ThreadMetrics* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(freeMutex);
+            if (!freeBlocks.empty()) {
+                ThreadMetrics* block = freeBlocks.back();
+                freeBlocks.pop_back();
+                return block;
+            }
         }
-        if (lineNum % 10000000 == 0) {
-            auto currentTime = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> elapsed = currentTime - startTime;
-            double rate = lineNum / elapsed.count();
-            std::clog << "[" << getCurrentTimestamp() << "] Processed " << lineNum << " lines... (" 
-                      << static_cast<int>(rate) << " lines/sec)\n";
+        int index = numBlocks.load();
+        while (index < kMaxBlocks && !numBlocks.compare_exchange_weak(index, index + 1)) {}
+        if (index >= kMaxBlocks)
+            return &overflow;
+        ThreadMetrics* block = new ThreadMetrics();
+        blocks[index].store(block, std::memory_order_release);
+        return block;
+    }
+
+    void release(ThreadMetrics* block) {
+        if (block == &overflow)
+            return;
+        std::lock_guard<std::mutex> lock(freeMutex);
+        freeBlocks.push_back(block);
+    }
+
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        int n = numBlocks.load();
+        for (int i = 0; i < n; i++) {
+            ThreadMetrics* block = blocks[i].load(std::memory_order_acquire);
+            if (block)
+                visit(*block);
         }
+        visit(overflow);
     }
-    
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = endTime - startTime;
-    double rate = count > 0 ? count / elapsed.count() : 0;
-    
-    std::clog << "[" << getCurrentTimestamp() << "] Parsed " << count << " triples from " << lineNum << " lines in " 
-              << formatDuration(elapsed) << " (" << static_cast<int>(rate) << " triples/sec).\n";
-    return graph;
+};
+
+MetricsRegistry& metricsRegistry() {
+    static MetricsRegistry registry;
+    return registry;
 }
 
-// Enhanced randomWalk function with duplicate avoidance
-std::vector<std::string> randomWalk(const Graph& graph, const std::string& start, int length, 
-                                   std::mt19937& rng, 
-                                   const std::set<std::string>* visitedWalkStrings = nullptr) {
-    std::vector<std::string> walk{start};
-    std::string current = start;
-    
-    // For tracking choices made at each step to allow backtracking
-    std::vector<std::pair<int, std::vector<int>>> choicesHistory;
-    
-    // Walk length now refers to number of entities (excluding predicates)
-    // We'll add predicates in between, so the final path length could be up to 2*length - 1
-    for (int i = 0; i < length - 1; i++) {  // -1 because we already have the start node
-        auto it = graph.find(current);
-        if (it == graph.end() || it->second.empty())
-            break;
-            
-        const auto &edges = it->second;
-        
-        // Record all possible choices at this step
-        std::vector<int> availableChoices;
-        for (int j = 0; j < static_cast<int>(edges.size()); j++) {
-            availableChoices.push_back(j);
+ThreadMetrics& threadMetrics() {
+    struct Holder {
+        ThreadMetrics* block = metricsRegistry().acquire();
+        ~Holder() { metricsRegistry().release(block); }
+    };
+    thread_local Holder holder;
+    return *holder.block;
+}
+
+// Times a scope into a phase when metrics are on
+class PhaseTimer {
+private:
+    MetricPhase phase;
+    uint64_t start;
+
+public:
+    explicit PhaseTimer(MetricPhase phase) : phase(phase), start(gMetricsEnabled ? metricsClock() : 0) {}
+    ~PhaseTimer() {
+        if (gMetricsEnabled)
+            threadMetrics().record(phase, metricsClock() - start);
+    }
+};
+
+// All threads' metrics summed
+struct MetricsSnapshot {
+    uint64_t counters[kNumCounters] = {};
+    uint64_t counts[kNumPhases][LatencyHistogram::kNumBuckets] = {};
+    uint64_t total[kNumPhases] = {};
+    uint64_t sum[kNumPhases] = {};
+    uint64_t max[kNumPhases] = {};
+
+    // Upper bound of the bucket holding quantile q, in nanoseconds
+    uint64_t quantile(int phase, double q) const {
+        if (total[phase] == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * total[phase]));
+        uint64_t seen = 0;
+        for (int b = 0; b < LatencyHistogram::kNumBuckets; b++) {
+            seen += counts[phase][b];
+            if (seen >= std::max<uint64_t>(rank, 1))
+                return std::min(LatencyHistogram::bucketLimit(b), max[phase]);
         }
-        
-        // If only one option, no need to shuffle
-        if (availableChoices.size() > 1) {
-            std::shuffle(availableChoices.begin(), availableChoices.end(), rng);
+        return max[phase];
+    }
+};
+
+std::unique_ptr<MetricsSnapshot> collectMetrics() {
+    auto snapshot = std::make_unique<MetricsSnapshot>();
+    metricsRegistry().forEach([&](const ThreadMetrics& block) {
+        for (int c = 0; c < kNumCounters; c++)
+            snapshot->counters[c] += block.counters[c].load(std::memory_order_relaxed);
+        for (int p = 0; p < kNumPhases; p++) {
+            const LatencyHistogram& histogram = block.phases[p];
+            for (int b = 0; b < LatencyHistogram::kNumBuckets; b++)
+                snapshot->counts[p][b] += histogram.counts[b].load(std::memory_order_relaxed);
+            snapshot->total[p] += histogram.total.load(std::memory_order_relaxed);
+            snapshot->sum[p] += histogram.sum.load(std::memory_order_relaxed);
+            snapshot->max[p] = std::max(snapshot->max[p], histogram.max.load(std::memory_order_relaxed));
         }
-        
-        // Select the first available choice
-        int edgeIndex = availableChoices[0];
-        
-        // Store the choice made and remaining options for potential backtracking
-        choicesHistory.push_back({edgeIndex, availableChoices});
-        
-        // Add both predicate and target to the walk
-        walk.push_back(edges[edgeIndex].predicate);
-        walk.push_back(edges[edgeIndex].target);
-        
-        current = edges[edgeIndex].target;
+    });
+    return snapshot;
+}
+
+// Prometheus text exposition format: counters, and one summary per phase
+std::string formatMetrics() {
+    auto snapshot = collectMetrics();
+    std::ostringstream out;
+    out << std::setprecision(9);
+    for (int c = 0; c < kNumCounters; c++) {
+        out << "# TYPE random_walker_" << kCounterNames[c] << "_total counter\n"
+            << "random_walker_" << kCounterNames[c] << "_total " << snapshot->counters[c] << "\n";
     }
-    
-    return walk;
+    out << "# TYPE random_walker_phase_seconds summary\n";
+    for (int p = 0; p < kNumPhases; p++) {
+        for (double q : {0.5, 0.9, 0.99, 0.999}) {
+            out << "random_walker_phase_seconds{phase=\"" << kPhaseNames[p] << "\",quantile=\"" << q << "\"} " 
+                << snapshot->quantile(p, q) * 1e-9 << "\n";
+        }
+        out << "random_walker_phase_seconds_sum{phase=\"" << kPhaseNames[p] << "\"} " << snapshot->sum[p] * 1e-9 << "\n"
+            << "random_walker_phase_seconds_count{phase=\"" << kPhaseNames[p] << "\"} " << snapshot->total[p] << "\n";
+    }
+    out << "# TYPE random_walker_phase_max_seconds gauge\n";
+    for (int p = 0; p < kNumPhases; p++) {
+        out << "random_walker_phase_max_seconds{phase=\"" << kPhaseNames[p] << "\"} " << snapshot->max[p] * 1e-9 << "\n";
+    }
+    return out.str();
 }
 
-// Generate a string representation of a walk for duplicate detection
-std::string walkToString(const std::vector<std::string>& walk) {
-    std::stringstream ss;
-    for (const auto& node : walk) {
-        ss << node << ",";
+// Per-phase breakdown for the log at the end of a run
+void logMetricsSummary() {
+    auto snapshot = collectMetrics();
+    std::clog << "[" << getCurrentTimestamp() << "] Phase breakdown (p50 / p99 / max, total time; sampled phases "
+              << "time 1 in " << kMetricsSampleEvery << " walks):\n";
+    auto nanos = [](uint64_t ns) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        if (ns < 1000)
+            ss << ns << " ns";
+        else if (ns < 1000000)
+            ss << ns * 1e-3 << " us";
+        else if (ns < 1000000000)
+            ss << ns * 1e-6 << " ms";
+        else
+            ss << ns * 1e-9 << " s";
+        return ss.str();
+    };
+    for (int p = 0; p < kNumPhases; p++) {
+        if (snapshot->total[p] == 0)
+            continue;
+        std::clog << "[" << getCurrentTimestamp() << "]   " << std::left << std::setw(12) << kPhaseNames[p] << std::right 
+                  << snapshot->total[p] << " samples: " << nanos(snapshot->quantile(p, 0.5)) << " / " 
+                  << nanos(snapshot->quantile(p, 0.99)) << " / " << nanos(snapshot->max[p]) << ", " 
+                  << nanos(snapshot->sum[p]) << "\n";
     }
-    return ss.str();
+    std::clog << "[" << getCurrentTimestamp() << "]   counters:";
+    for (int c = 0; c < kNumCounters; c++)
+        std::clog << " " << kCounterNames[c] << "=" << snapshot->counters[c];
+    std::clog << "\n";
 }
 
-// Create a new function that generates distinct walks
-std::vector<std::vector<std::string>> generateDistinctWalks(
-    const Graph& graph, const std::string& startNode, int numWalks, int walkLength, std::mt19937& rng) {
-    
-    std::vector<std::vector<std::string>> walks;
-    std::set<std::string> walkStrings; // To track unique walks
-    
+// Per-thread result of parsing one newline-aligned chunk of the input. Terms
+// are views into the mapped file, or into `storage` for terms that had to be
+// rewritten, and get local IDs until they are merged into the global
+// dictionary.
+struct ChunkParse {
+    std::unordered_map<std::string_view, NodeId> localIds;
+    std::vector<std::string_view> localTerms;
+    std::deque<std::string> storage;
+    std::vector<Triple> triples;
+    size_t lines = 0;
+    std::vector<std::pair<size_t, std::string_view>> failures;  // (line within chunk, text)
+
+    NodeId intern(std::string_view term) {
+        auto it = localIds.find(term);
+        if (it != localIds.end())
+            return it->second;
+        NodeId id = static_cast<NodeId>(localTerms.size());
+        localTerms.push_back(term);
+        localIds.emplace(term, id);
+        return id;
+    }
+
+    // Intern a term built while parsing, keeping one copy of it
+    NodeId internCopy(std::string_view term) {
+        auto it = localIds.find(term);
+        if (it != localIds.end())
+            return it->second;
+        storage.emplace_back(term);
+        return intern(storage.back());
+    }
+};
+
+// Parse the lines of [begin, end) with parseLine(line, chunk), which adds the
+// line's triples to the chunk and returns false for a malformed line. Blank
+// lines and '#' comments are skipped.
+template <typename LineParser>
+void parseChunk(const char* begin, const char* end, ChunkParse& chunk, LineParser& parseLine,
+                std::atomic<size_t>& linesProcessed, std::mutex& logMutex,
+                std::chrono::high_resolution_clock::time_point startTime) {
+    PhaseTimer timer(kPhaseParse);
+    const size_t reportEvery = 1000000;
+    size_t unreported = 0;
+    const char* p = begin;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        std::string_view line(p, eol - p);
+        p = eol + 1;
+        chunk.lines++;
+
+        if (++unreported == reportEvery) {
+            size_t before = linesProcessed.fetch_add(unreported);
+            size_t after = before + unreported;
+            unreported = 0;
+            if (before / 10000000 != after / 10000000) {
+                std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+                double rate = after / elapsed.count();
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::clog << "[" << getCurrentTimestamp() << "] Processed " << after << " lines... (" 
+                          << static_cast<int>(rate) << " lines/sec)\n";
+            }
+        }
+
+        size_t first = 0;
+        while (first < line.size() && isBlank(line[first]))
+            first++;
+        if (first == line.size() || line[first] == '#')
+            continue;
+
+        if (!parseLine(line, chunk))
+            chunk.failures.emplace_back(chunk.lines, line);
+    }
+    linesProcessed += unreported;
+    if (gMetricsEnabled) {
+        threadMetrics().add(kCounterLines, chunk.lines);
+        threadMetrics().add(kCounterTriples, chunk.triples.size());
+    }
+}
+
+// Split the mapped range [data, dataEnd) into one chunk per thread, each
+// ending just after a newline, and parse them in parallel; the chunks are
+// appended to `chunks` in file order (a deque, so the terms of earlier
+// chunks stay where they are). Failures are reported afterwards with
+// global line numbers (counting from firstLine). Returns the number of lines.
+template <typename LineParser>
+size_t parseMappedRange(const char* data, const char* dataEnd, size_t firstLine, int numThreads, 
+                        LineParser parseLine, std::deque<ChunkParse>& chunks,
+                        std::chrono::high_resolution_clock::time_point startTime) {
+    size_t size = dataEnd - data;
+    size_t numChunks = std::max(1, numThreads);
+    std::vector<const char*> bounds{data};
+    for (size_t i = 1; i < numChunks; i++) {
+        const char* cut = data + size * i / numChunks;
+        cut = std::max(cut, bounds.back());
+        const char* eol = static_cast<const char*>(memchr(cut, '\n', dataEnd - cut));
+        bounds.push_back(eol ? eol + 1 : dataEnd);
+    }
+    bounds.push_back(dataEnd);
+
+    size_t firstChunk = chunks.size();
+    chunks.resize(firstChunk + numChunks);
+    std::atomic<size_t> linesProcessed{0};
+    std::mutex logMutex;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numChunks; i++) {
+        threads.emplace_back([&, i]() {
+            LineParser parser = parseLine;
+            parseChunk(bounds[i], bounds[i + 1], chunks[firstChunk + i], parser, linesProcessed, logMutex, startTime);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t lineNum = firstLine;
+    for (size_t i = firstChunk; i < chunks.size(); i++) {
+        for (const auto& failure : chunks[i].failures) {
+            std::clog << "[" << getCurrentTimestamp() << "] Failed to parse line " << lineNum + failure.first 
+                      << ": " << failure.second << "\n";
+        }
+        lineNum += chunks[i].lines;
+    }
+    return lineNum - firstLine;
+}
+
+// Merge the chunk dictionaries in order, remap the triples in parallel and
+// build the adjacency. With numShards > 1 only the edges of subjects owned by
+// `shard` are kept; the dictionary stays complete so IDs agree across shards.
+Graph buildGraphFromChunks(std::deque<ChunkParse>& chunks, size_t numLines, int numThreads, int shard, int numShards,
+                           std::chrono::high_resolution_clock::time_point startTime) {
+    Graph graph;
+    size_t numChunks = chunks.size();
+    size_t count = 0;
+    std::vector<std::vector<NodeId>> localToGlobal(numChunks);
+    for (size_t i = 0; i < numChunks; i++) {
+        PhaseTimer timer(kPhaseIntern);
+        auto& chunk = chunks[i];
+        count += chunk.triples.size();
+        localToGlobal[i].reserve(chunk.localTerms.size());
+        for (const auto& term : chunk.localTerms)
+            localToGlobal[i].push_back(graph.dict.intern(term));
+        chunk.localIds = {};
+        chunk.localTerms = {};
+        chunk.storage = {};
+    }
+
+    std::vector<std::vector<Triple>> parts(numChunks);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numChunks; i++) {
+        threads.emplace_back([&, i]() {
+            const auto& mapping = localToGlobal[i];
+            auto& triples = chunks[i].triples;
+            for (auto& t : triples)
+                t = {mapping[t.subject], mapping[t.predicate], mapping[t.object]};
+            if (numShards > 1) {
+                triples.erase(std::remove_if(triples.begin(), triples.end(), 
+                                             [&](const Triple& t) { return shardOf(t.subject, numShards) != shard; }),
+                              triples.end());
+            }
+            parts[i] = std::move(triples);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    buildAdjacency(graph, parts, numThreads);
+    
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = endTime - startTime;
+    double rate = count > 0 ? count / elapsed.count() : 0;
+    double lineRate = numLines > 0 ? numLines / elapsed.count() : 0;
+    
+    std::clog << "[" << getCurrentTimestamp() << "] Parsed " << count << " triples from " << numLines << " lines in " 
+              << formatDuration(elapsed) << " (" << static_cast<int>(rate) << " triples/sec, " 
+              << static_cast<int>(lineRate) << " lines/sec).\n";
+    std::clog << "[" << getCurrentTimestamp() << "] Interned " << graph.dict.size() << " terms (" 
+              << formatBytes(graph.dict.textBytes()) << " of text in " << graph.dict.numNamespaces() 
+              << " namespaces); graph uses "
+              << formatBytes(graph.memoryUsage()) << " (dictionary " << formatBytes(graph.dict.memoryUsage())
+              << ", adjacency " << formatBytes(graph.memoryUsage() - graph.dict.memoryUsage()) << ")\n";
+    return graph;
+}
+
+bool parseTripleLine(std::string_view line, ChunkParse& chunk) {
+    std::string_view subject, predicate, object;
+    if (!parseTriple(line, subject, predicate, object))
+        return false;
+    chunk.triples.push_back({chunk.intern(subject), chunk.intern(predicate), chunk.intern(object)});
+    return true;
+}
+
+// Memory-map the N-Triples or N-Quads file and parse newline-aligned chunks on numThreads
+// threads. The per-chunk dictionaries are then merged in file order, so node
+// IDs and edge order do not depend on the thread count.
+Graph loadGraph(const std::string& filename, int numThreads = 1, int shard = 0, int numShards = 1) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening file: " << filename << "\n";
+        return Graph();
+    }
+    file.adviseSequential();
+    std::clog << "[" << getCurrentTimestamp() << "] Parsing file: " << filename << " (" 
+              << formatBytes(file.size()) << ", " << numThreads << " threads)\n";
+    
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::deque<ChunkParse> chunks;
+    size_t numLines = parseMappedRange(file.data(), file.data() + file.size(), 0, numThreads, parseTripleLine, 
+                                       chunks, startTime);
+    return buildGraphFromChunks(chunks, numLines, numThreads, shard, numShards, startTime);
+}
+
+// Property graph CSV exports (apoc.export.csv.query, see
+// slurm_scripts/export_neo4j_to_csv.sh). Nodes become "pg:<id>" terms and
+// relationship types become predicates. With expandProperties, every other
+// node column and every key of the JSON `properties` column adds a hop from
+// the node to its value: a JSON literal such as "Ulm" (with the quotes) or
+// 1921. A relationship with properties (or other non-empty columns) is then
+// reified as a "pg:<start>-<type>-<end>" node in the middle of the hop,
+// start -type-> it -type-> end, carrying the same kind of property hops;
+// relationships without any stay a direct hop. Without expandProperties,
+// relationship properties are ignored.
+
+// Split one CSV record into fields, undoing "" escapes inside quoted fields.
+// Records may not contain raw newlines.
+bool splitCsvLine(std::string_view line, std::vector<std::string>& fields) {
+    size_t count = 0;
+    size_t i = 0;
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    for (;;) {
+        if (fields.size() <= count)
+            fields.emplace_back();
+        std::string& field = fields[count++];
+        field.clear();
+        if (i < line.size() && line[i] == '"') {
+            i++;
+            for (;;) {
+                if (i >= line.size())
+                    return false;
+                if (line[i] == '"') {
+                    if (i + 1 < line.size() && line[i + 1] == '"') {
+                        field.push_back('"');
+                        i += 2;
+                        continue;
+                    }
+                    i++;
+                    break;
+                }
+                field.push_back(line[i++]);
+            }
+            if (i < line.size() && line[i] != ',')
+                return false;
+        } else {
+            size_t comma = line.find(',', i);
+            size_t stop = comma == std::string_view::npos ? line.size() : comma;
+            field.append(line.data() + i, stop - i);
+            i = stop;
+        }
+        if (i >= line.size())
+            break;
+        i++;  // the comma
+    }
+    fields.resize(count);
+    return true;
+}
+
+// Skip one JSON value starting at json[i] (string, number, literal, or a
+// nested array/object) and return the index just past it, or npos
+size_t skipJsonValue(std::string_view json, size_t i) {
+    if (i >= json.size())
+        return std::string_view::npos;
+    if (json[i] == '"') {
+        for (i++; i < json.size(); i++) {
+            if (json[i] == '\\')
+                i++;
+            else if (json[i] == '"')
+                return i + 1;
+        }
+        return std::string_view::npos;
+    }
+    if (json[i] == '{' || json[i] == '[') {
+        int depth = 0;
+        for (; i < json.size(); i++) {
+            char c = json[i];
+            if (c == '"') {
+                i = skipJsonValue(json, i);
+                if (i == std::string_view::npos)
+                    return i;
+                i--;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return i + 1;
+            }
+        }
+        return std::string_view::npos;
+    }
+    while (i < json.size() && json[i] != ',' && json[i] != '}' && json[i] != ']' && !isBlank(json[i]))
+        i++;
+    return i;
+}
+
+// Key/value pairs of a flat JSON object; keys without quotes, values as raw JSON text
+bool parseJsonObject(std::string_view json, std::vector<std::pair<std::string_view, std::string_view>>& pairs) {
+    pairs.clear();
+    size_t i = 0;
+    auto skipBlanks = [&]() { while (i < json.size() && isBlank(json[i])) i++; };
+    skipBlanks();
+    if (i >= json.size())
+        return true;  // an empty column
+    if (json[i++] != '{')
+        return false;
+    skipBlanks();
+    if (i < json.size() && json[i] == '}')
+        return true;
+    for (;;) {
+        skipBlanks();
+        size_t keyEnd = skipJsonValue(json, i);
+        if (i >= json.size() || json[i] != '"' || keyEnd == std::string_view::npos)
+            return false;
+        std::string_view key = json.substr(i + 1, keyEnd - i - 2);
+        i = keyEnd;
+        skipBlanks();
+        if (i >= json.size() || json[i++] != ':')
+            return false;
+        skipBlanks();
+        size_t valueEnd = skipJsonValue(json, i);
+        if (valueEnd == std::string_view::npos || valueEnd == i)
+            return false;
+        pairs.emplace_back(key, json.substr(i, valueEnd - i));
+        i = valueEnd;
+        skipBlanks();
+        if (i >= json.size())
+            return false;
+        if (json[i] == '}')
+            return true;
+        if (json[i++] != ',')
+            return false;
+    }
+}
+
+// Column positions of a CSV header; -1 for a missing column
+int findColumn(const std::vector<std::string>& header, std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        auto it = std::find(header.begin(), header.end(), name);
+        if (it != header.end())
+            return static_cast<int>(it - header.begin());
+    }
+    return -1;
+}
+
+using JsonPairs = std::vector<std::pair<std::string_view, std::string_view>>;
+
+// Property hops of a CSV record from subject: every non-empty column not in
+// skip as a JSON string, then the pairs of its JSON properties column
+void addPropertyHops(ChunkParse& chunk, NodeId subject, const std::vector<std::string>& columns, 
+                     const std::vector<std::string>& fields, const std::vector<int>& skip, 
+                     const JsonPairs& pairs, std::string& term) {
+    for (int c = 0; c < static_cast<int>(columns.size()); c++) {
+        if (fields[c].empty() || std::find(skip.begin(), skip.end(), c) != skip.end())
+            continue;
+        // Plain columns become JSON strings, like the values in properties
+        term.assign("\"");
+        for (char ch : fields[c]) {
+            if (ch == '"' || ch == '\\')
+                term.push_back('\\');
+            term.push_back(ch);
+        }
+        term.push_back('"');
+        chunk.triples.push_back({subject, chunk.internCopy(columns[c]), chunk.internCopy(term)});
+    }
+    for (const auto& pair : pairs)
+        chunk.triples.push_back({subject, chunk.internCopy(pair.first), chunk.internCopy(pair.second)});
+}
+
+// "pg:<id>" in a reused buffer
+inline std::string_view pgNodeTerm(std::string& buffer, const std::string& id) {
+    buffer.assign("pg:");
+    buffer.append(id);
+    return buffer;
+}
+
+// Load a property graph from its nodes and edges CSV files. Both files are
+// mapped and parsed in parallel chunks into one dictionary.
+Graph loadPropertyGraph(const std::string& nodesFile, const std::string& edgesFile, bool expandProperties,
+                        int numThreads = 1, int shard = 0, int numShards = 1) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::deque<ChunkParse> chunks;
+    size_t numLines = 0;
+    std::vector<std::string> header;
+    
+    // Returns the mapped data after the header line
+    auto openCsv = [&](MappedFile& file, const std::string& filename) -> const char* {
+        if (!file.open(filename)) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error opening file: " << filename << "\n";
+            return nullptr;
+        }
+        file.adviseSequential();
+        std::clog << "[" << getCurrentTimestamp() << "] Parsing file: " << filename << " (" 
+                  << formatBytes(file.size()) << ", " << numThreads << " threads)\n";
+        const char* end = file.data() + file.size();
+        const char* eol = static_cast<const char*>(memchr(file.data(), '\n', file.size()));
+        if (!eol)
+            eol = end;
+        if (!splitCsvLine(std::string_view(file.data(), eol - file.data()), header)) {
+            std::clog << "[" << getCurrentTimestamp() << "] Malformed CSV header in " << filename << "\n";
+            return nullptr;
+        }
+        return eol < end ? eol + 1 : end;
+    };
+    
+    MappedFile nodes;
+    if (expandProperties) {
+        const char* data = openCsv(nodes, nodesFile);
+        if (!data)
+            return Graph();
+        int idColumn = findColumn(header, {"id", "_id"});
+        int propertiesColumn = findColumn(header, {"properties"});
+        if (idColumn < 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] No id column in " << nodesFile << "\n";
+            return Graph();
+        }
+        std::vector<std::string> columns = header;
+        std::vector<int> skip{idColumn, propertiesColumn};
+        auto parseNode = [=, fields = std::vector<std::string>(), term = std::string(), pairs = JsonPairs()]
+                         (std::string_view line, ChunkParse& chunk) mutable {
+            if (!splitCsvLine(line, fields) || fields.size() != columns.size())
+                return false;
+            pairs.clear();
+            if (propertiesColumn >= 0 && !parseJsonObject(fields[propertiesColumn], pairs))
+                return false;
+            NodeId node = chunk.internCopy(pgNodeTerm(term, fields[idColumn]));
+            addPropertyHops(chunk, node, columns, fields, skip, pairs, term);
+            return true;
+        };
+        numLines += 1 + parseMappedRange(data, nodes.data() + nodes.size(), 1, numThreads, parseNode, chunks, startTime);
+    }
+    
+    MappedFile edges;
+    const char* data = openCsv(edges, edgesFile);
+    if (!data)
+        return Graph();
+    int startColumn = findColumn(header, {"start", "_start"});
+    int endColumn = findColumn(header, {"end", "_end"});
+    int typeColumn = findColumn(header, {"type", "_type"});
+    if (startColumn < 0 || endColumn < 0 || typeColumn < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] " << edgesFile << " needs start, end and type columns\n";
+        return Graph();
+    }
+    int propertiesColumn = findColumn(header, {"properties"});
+    std::vector<std::string> columns = header;
+    std::vector<int> skip{startColumn, endColumn, typeColumn, propertiesColumn};
+    auto parseEdge = [=, fields = std::vector<std::string>(), term = std::string(), pairs = JsonPairs()]
+                     (std::string_view line, ChunkParse& chunk) mutable {
+        if (!splitCsvLine(line, fields) || fields.size() != columns.size())
+            return false;
+        pairs.clear();
+        bool reified = false;
+        if (expandProperties) {
+            if (propertiesColumn >= 0 && !parseJsonObject(fields[propertiesColumn], pairs))
+                return false;
+            reified = !pairs.empty();
+            for (int c = 0; c < static_cast<int>(columns.size()) && !reified; c++)
+                reified = !fields[c].empty() && std::find(skip.begin(), skip.end(), c) == skip.end();
+        }
+        NodeId start = chunk.internCopy(pgNodeTerm(term, fields[startColumn]));
+        NodeId end = chunk.internCopy(pgNodeTerm(term, fields[endColumn]));
+        NodeId type = chunk.internCopy(fields[typeColumn]);
+        if (!reified) {
+            chunk.triples.push_back({start, type, end});
+            return true;
+        }
+        pgNodeTerm(term, fields[startColumn]);
+        term.append("-").append(fields[typeColumn]).append("-").append(fields[endColumn]);
+        NodeId edge = chunk.internCopy(term);
+        chunk.triples.push_back({start, type, edge});
+        chunk.triples.push_back({edge, type, end});
+        addPropertyHops(chunk, edge, columns, fields, skip, pairs, term);
+        return true;
+    };
+    numLines += 1 + parseMappedRange(data, edges.data() + edges.size(), 1, numThreads, parseEdge, chunks, startTime);
+    return buildGraphFromChunks(chunks, numLines, numThreads, shard, numShards, startTime);
+}
+
+// Binary graph snapshot. The file is a fixed header followed by the raw
+// dictionary and adjacency arrays, each starting on a page boundary, so a
+// snapshot can be mapped and used in place. Every section carries its own
+// checksum and the header checksums itself.
+const char kSnapshotMagic[8] = {'R', 'W', 'G', 'R', 'A', 'P', 'H', '\0'};
+const uint32_t kSnapshotVersion = 3;   // 2: edges of a node are sorted by target; 3: term namespaces
+const uint32_t kSnapshotByteOrder = 0x01020304;
+const uint64_t kSnapshotAlignment = 4096;
+
+enum SnapshotSectionId {
+    kSectionText,
+    kSectionTextOffsets,
+    kSectionSlots,
+    kSectionOffsets,
+    kSectionEdges,
+    kSectionNamespaceText,
+    kSectionNamespaceOffsets,
+    kNumSnapshotSections
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t numTerms;
+    uint64_t numEdges;
+    SnapshotSection sections[kNumSnapshotSections];
+    uint64_t headerChecksum;  // over all preceding header bytes
+};
+
+bool saveGraphSnapshot(const Graph& graph, const std::string& filename) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::clog << "[" << getCurrentTimestamp() << "] Writing graph snapshot: " << filename << "\n";
+
+    const Dictionary& dict = graph.dict;
+    std::pair<const char*, uint64_t> payloads[kNumSnapshotSections] = {
+        {dict.text.data(), dict.text.bytes()},
+        {reinterpret_cast<const char*>(dict.textOffsets.data()), dict.textOffsets.bytes()},
+        {reinterpret_cast<const char*>(dict.slots.data()), dict.slots.bytes()},
+        {reinterpret_cast<const char*>(graph.offsets.data()), graph.offsets.bytes()},
+        {reinterpret_cast<const char*>(graph.edges.data()), graph.edges.bytes()},
+        {dict.namespaceText.data(), dict.namespaceText.bytes()},
+        {reinterpret_cast<const char*>(dict.namespaceOffsets.data()), dict.namespaceOffsets.bytes()},
+    };
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.byteOrder = kSnapshotByteOrder;
+    header.numTerms = dict.size();
+    header.numEdges = graph.numEdges();
+
+    uint64_t position = kSnapshotAlignment;
+    for (int i = 0; i < kNumSnapshotSections; i++) {
+        header.sections[i].offset = position;
+        header.sections[i].bytes = payloads[i].second;
+        header.sections[i].checksum = hashBytes(payloads[i].first, payloads[i].second);
+        position += (payloads[i].second + kSnapshotAlignment - 1) / kSnapshotAlignment * kSnapshotAlignment;
+    }
+    header.headerChecksum = hashBytes(reinterpret_cast<const char*>(&header), offsetof(SnapshotHeader, headerChecksum));
+
+    // Write to a temporary name and rename, so readers never map a partial file
+    std::string tmpFile = filename + ".tmp";
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening snapshot file: " << tmpFile << "\n";
+        return false;
+    }
+    std::vector<char> padding(kSnapshotAlignment, 0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding.data(), kSnapshotAlignment - sizeof(header));
+    for (int i = 0; i < kNumSnapshotSections; i++) {
+        out.write(payloads[i].first, payloads[i].second);
+        uint64_t tail = payloads[i].second % kSnapshotAlignment;
+        if (tail != 0)
+            out.write(padding.data(), kSnapshotAlignment - tail);
+    }
+    out.close();
+    if (!out || std::rename(tmpFile.c_str(), filename.c_str()) != 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error writing snapshot file: " << filename << "\n";
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    std::clog << "[" << getCurrentTimestamp() << "] Wrote " << formatBytes(position) << " snapshot in " 
+              << formatDuration(elapsed) << "\n";
+    return true;
+}
+
+// Map a snapshot written by saveGraphSnapshot. The returned graph points into
+// the mapping, so concurrent walker processes share the pages through the
+// page cache. Returns an empty graph if the file is missing or corrupt.
+Graph loadGraphSnapshot(const std::string& filename) {
+    Graph graph;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening snapshot file: " << filename << "\n";
+        return graph;
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Mapping graph snapshot: " << filename << " (" 
+              << formatBytes(file->size()) << ")\n";
+
+    SnapshotHeader header;
+    if (file->size() < sizeof(header)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Snapshot file is truncated: " << filename << "\n";
+        return graph;
+    }
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Not a graph snapshot: " << filename << "\n";
+        return graph;
+    }
+    if (header.version != kSnapshotVersion || header.byteOrder != kSnapshotByteOrder) {
+        std::clog << "[" << getCurrentTimestamp() << "] Unsupported snapshot version " << header.version 
+                  << " (expected " << kSnapshotVersion << ") or byte order\n";
+        return graph;
+    }
+    if (header.headerChecksum != hashBytes(reinterpret_cast<const char*>(&header), offsetof(SnapshotHeader, headerChecksum))) {
+        std::clog << "[" << getCurrentTimestamp() << "] Snapshot header checksum mismatch: " << filename << "\n";
+        return graph;
+    }
+
+    const size_t elementSizes[kNumSnapshotSections] = {
+        sizeof(char), sizeof(uint64_t), sizeof(NodeId), sizeof(uint64_t), sizeof(Edge), sizeof(char), sizeof(uint32_t)
+    };
+    for (int i = 0; i < kNumSnapshotSections; i++) {
+        const auto& section = header.sections[i];
+        if (section.offset % kSnapshotAlignment != 0 || section.offset > file->size() ||
+            section.bytes > file->size() - section.offset || section.bytes % elementSizes[i] != 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] Snapshot section " << i << " is out of bounds\n";
+            return graph;
+        }
+    }
+    const auto* sections = header.sections;
+    size_t numSlots = sections[kSectionSlots].bytes / sizeof(NodeId);
+    size_t numNamespaceOffsets = sections[kSectionNamespaceOffsets].bytes / sizeof(uint32_t);
+    if (numSlots <= header.numTerms || (numSlots & (numSlots - 1)) != 0 || numNamespaceOffsets % 2 != 1 ||
+        sections[kSectionTextOffsets].bytes != (header.numTerms + 1) * sizeof(uint64_t) ||
+        sections[kSectionOffsets].bytes != (header.numTerms + 1) * sizeof(uint64_t) ||
+        sections[kSectionEdges].bytes != header.numEdges * sizeof(Edge)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Snapshot section sizes do not match the header\n";
+        return graph;
+    }
+
+    // Verify the section checksums in parallel; this also faults the pages in
+    bool checksumsOk[kNumSnapshotSections];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumSnapshotSections; i++) {
+        threads.emplace_back([&, i]() {
+            const auto& section = sections[i];
+            checksumsOk[i] = hashBytes(file->data() + section.offset, section.bytes) == section.checksum;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int i = 0; i < kNumSnapshotSections; i++) {
+        if (!checksumsOk[i]) {
+            std::clog << "[" << getCurrentTimestamp() << "] Snapshot section " << i << " checksum mismatch\n";
+            return graph;
+        }
+    }
+
+    auto sectionData = [&](SnapshotSectionId id) { return file->data() + sections[id].offset; };
+    graph.dict.text.mapFrom(sectionData(kSectionText), sections[kSectionText].bytes);
+    graph.dict.textOffsets.mapFrom(reinterpret_cast<const uint64_t*>(sectionData(kSectionTextOffsets)), header.numTerms + 1);
+    graph.dict.slots.mapFrom(reinterpret_cast<const NodeId*>(sectionData(kSectionSlots)), numSlots);
+    graph.dict.namespaceText.mapFrom(sectionData(kSectionNamespaceText), sections[kSectionNamespaceText].bytes);
+    graph.dict.namespaceOffsets.mapFrom(reinterpret_cast<const uint32_t*>(sectionData(kSectionNamespaceOffsets)), 
+                                        numNamespaceOffsets);
+    graph.offsets.mapFrom(reinterpret_cast<const uint64_t*>(sectionData(kSectionOffsets)), header.numTerms + 1);
+    graph.edges.mapFrom(reinterpret_cast<const Edge*>(sectionData(kSectionEdges)), header.numEdges);
+    graph.snapshot = std::move(file);
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    std::clog << "[" << getCurrentTimestamp() << "] Mapped " << header.numTerms << " terms and " << header.numEdges 
+              << " edges in " << formatDuration(elapsed) << "\n";
+    return graph;
+}
+
+// Replace the adjacency of a loaded graph (e.g. a mapped snapshot) with the
+// out-edges of the nodes owned by `shard`. The dictionary is left in place.
+void restrictToShard(Graph& graph, int shard, int numShards) {
+    size_t numNodes = graph.numNodes();
+    std::vector<uint64_t> offsets(numNodes + 1, 0);
+    std::vector<Edge> edges;
+    for (size_t node = 0; node < numNodes; node++) {
+        if (shardOf(static_cast<NodeId>(node), numShards) == shard) {
+            const Edge* begin = graph.edgesOf(static_cast<NodeId>(node));
+            edges.insert(edges.end(), begin, begin + graph.degree(static_cast<NodeId>(node)));
+        }
+        offsets[node + 1] = edges.size();
+    }
+    graph.offsets.assign(std::move(offsets));
+    graph.edges.assign(std::move(edges));
+}
+
+// Read per-predicate sampling weights: one "<predicate> weight" pair per
+// line, '#' starts a comment. Predicates may be written with or without the
+// angle brackets. Unlisted predicates keep weight 1; a weight of 0 removes
+// the predicate from the walks.
+bool loadPredicateWeights(const Graph& graph, const std::string& filename, std::vector<float>& weights) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening predicate weights file: " << filename << "\n";
+        return false;
+    }
+    weights.assign(graph.dict.size(), 1.0f);
+    std::string line;
+    int lineNum = 0, applied = 0;
+    while (std::getline(file, line)) {
+        lineNum++;
+        std::istringstream iss(line);
+        std::string predicate;
+        float weight;
+        if (!(iss >> predicate) || predicate[0] == '#')
+            continue;
+        if (!(iss >> weight) || weight < 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] Invalid predicate weight on line " << lineNum << ": " << line << "\n";
+            return false;
+        }
+        NodeId id = graph.dict.find(predicate);
+        if (id == kInvalidNode && predicate.front() != '<')
+            id = graph.dict.find("<" + predicate + ">");
+        if (id == kInvalidNode) {
+            std::clog << "[" << getCurrentTimestamp() << "] Predicate not in graph, ignoring: " << predicate << "\n";
+            continue;
+        }
+        weights[id] = weight;
+        applied++;
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Loaded " << applied << " predicate weights from " << filename << "\n";
+    return true;
+}
+
+// Vose's alias method for the out-edges of every node, weighted by predicate.
+// Nodes are split into ranges of roughly equal edge count, one per thread,
+// and each thread reuses its scratch lists across nodes.
+void buildAliasTables(Graph& graph, const std::vector<float>& predicateWeights, int numThreads) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    size_t numNodes = graph.numNodes();
+    size_t numEdges = graph.numEdges();
+    std::vector<uint32_t> threshold(numEdges);
+    std::vector<uint32_t> alias(numEdges);
+
+    std::vector<size_t> bounds{0};
+    for (int t = 1; t < numThreads; t++) {
+        uint64_t target = numEdges * t / numThreads;
+        const uint64_t* it = std::lower_bound(graph.offsets.begin(), graph.offsets.end() - 1, target);
+        bounds.push_back(std::max<size_t>(bounds.back(), it - graph.offsets.begin()));
+    }
+    bounds.push_back(numNodes);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<double> scaled;
+            std::vector<uint32_t> small, large;
+            for (size_t node = bounds[t]; node < bounds[t + 1]; node++) {
+                uint64_t offset = graph.offsets[node];
+                size_t degree = graph.degree(static_cast<NodeId>(node));
+                if (degree == 0)
+                    continue;
+                const Edge* edges = graph.edgesOf(static_cast<NodeId>(node));
+                double total = 0;
+                for (size_t j = 0; j < degree; j++)
+                    total += predicateWeights[edges[j].predicate];
+                if (total <= 0) {
+                    // Nothing to follow from this node
+                    std::fill(threshold.begin() + offset, threshold.begin() + offset + degree, 0);
+                    std::fill(alias.begin() + offset, alias.begin() + offset + degree, kNoEdge);
+                    continue;
+                }
+
+                scaled.resize(degree);
+                small.clear();
+                large.clear();
+                for (size_t j = 0; j < degree; j++) {
+                    scaled[j] = predicateWeights[edges[j].predicate] * degree / total;
+                    (scaled[j] < 1.0 ? small : large).push_back(static_cast<uint32_t>(j));
+                }
+                while (!small.empty() && !large.empty()) {
+                    uint32_t s = small.back(), l = large.back();
+                    small.pop_back();
+                    threshold[offset + s] = static_cast<uint32_t>(scaled[s] * 4294967296.0);
+                    alias[offset + s] = l;
+                    scaled[l] -= 1.0 - scaled[s];
+                    if (scaled[l] < 1.0) {
+                        large.pop_back();
+                        small.push_back(l);
+                    }
+                }
+                // Whatever is left has probability 1 up to rounding
+                for (uint32_t j : large) {
+                    threshold[offset + j] = std::numeric_limits<uint32_t>::max();
+                    alias[offset + j] = j;
+                }
+                for (uint32_t j : small) {
+                    threshold[offset + j] = std::numeric_limits<uint32_t>::max();
+                    alias[offset + j] = j;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    graph.aliasThreshold.assign(std::move(threshold));
+    graph.aliasIndex.assign(std::move(alias));
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    std::clog << "[" << getCurrentTimestamp() << "] Built alias tables for " << numEdges << " edges in " 
+              << formatDuration(elapsed) << " using " << numThreads << " threads (" 
+              << formatBytes(graph.aliasThreshold.bytes() + graph.aliasIndex.bytes()) << ")\n";
+}
+
+// Batch of triples to add to or remove from a live graph, parsed from an
+// N-Triples or N-Quads file. Triples refer to `terms` by index, since new
+// terms get graph IDs only when the batch is applied.
+struct GraphDelta {
+    bool remove = false;
+    std::vector<std::string> terms;
+    std::vector<Triple> triples;
+};
+
+bool loadGraphDelta(const std::string& filename, bool remove, int numThreads, GraphDelta& delta) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening file: " << filename << "\n";
+        return false;
+    }
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::deque<ChunkParse> chunks;
+    parseMappedRange(file.data(), file.data() + file.size(), 0, numThreads, parseTripleLine, chunks, startTime);
+    delta.remove = remove;
+    for (auto& chunk : chunks) {
+        NodeId base = static_cast<NodeId>(delta.terms.size());
+        delta.terms.insert(delta.terms.end(), chunk.localTerms.begin(), chunk.localTerms.end());
+        for (const auto& t : chunk.triples)
+            delta.triples.push_back({base + t.subject, base + t.predicate, base + t.object});
+    }
+    return true;
+}
+
+struct TripleHash {
+    size_t operator()(const Triple& t) const {
+        return mix64((static_cast<uint64_t>(t.subject) << 32 | t.predicate) ^ mix64(t.object));
+    }
+};
+
+inline bool operator==(const Triple& a, const Triple& b) {
+    return a.subject == b.subject && a.predicate == b.predicate && a.object == b.object;
+}
+
+inline bool operator==(const Edge& a, const Edge& b) {
+    return a.target == b.target && a.predicate == b.predicate;
+}
+
+// Merge a base graph with deltas applied in order (the last add or remove of
+// a triple wins) into a new graph. Node IDs of the base are kept and new
+// terms are appended, so walks, start nodes and dictionaries stay valid
+// across versions. Removing a triple drops every copy of it; adding one the
+// graph already has is a no-op. Untouched nodes copy their sorted edge runs
+// as they are, and node ranges are merged on numThreads threads.
+Graph applyGraphDeltas(const Graph& base, const std::vector<GraphDelta>& deltas, 
+                       const std::vector<float>& predicateWeights, int numThreads) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    Graph graph;
+    graph.dict = base.dict.clone();
+    
+    std::unordered_map<Triple, bool, TripleHash> changes;   // triple -> added
+    std::vector<NodeId> ids;
+    for (const auto& delta : deltas) {
+        ids.assign(delta.terms.size(), kInvalidNode);
+        for (size_t i = 0; i < delta.terms.size(); i++)
+            ids[i] = delta.remove ? graph.dict.find(delta.terms[i]) : graph.dict.intern(delta.terms[i]);
+        for (const auto& t : delta.triples) {
+            Triple triple{ids[t.subject], ids[t.predicate], ids[t.object]};
+            if (triple.subject != kInvalidNode && triple.predicate != kInvalidNode && triple.object != kInvalidNode)
+                changes[triple] = !delta.remove;
+        }
+    }
+    
+    // Changes sorted by subject and then edge order
+    std::vector<std::pair<NodeId, Edge>> added, removed;
+    for (const auto& change : changes)
+        (change.second ? added : removed).push_back({change.first.subject, {change.first.predicate, change.first.object}});
+    auto bySubject = [](const std::pair<NodeId, Edge>& a, const std::pair<NodeId, Edge>& b) {
+        return a.first != b.first ? a.first < b.first : a.second < b.second;
+    };
+    std::sort(added.begin(), added.end(), bySubject);
+    std::sort(removed.begin(), removed.end(), bySubject);
+    
+    size_t numNodes = graph.dict.size();
+    size_t baseNodes = base.numNodes();
+    numThreads = std::max(1, std::min<int>(numThreads, static_cast<int>(numNodes)));
+    std::vector<std::vector<Edge>> partEdges(numThreads);
+    std::vector<uint64_t> degrees(numNodes + 1, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            size_t first = numNodes * t / numThreads, last = numNodes * (t + 1) / numThreads;
+            auto position = [&](const std::vector<std::pair<NodeId, Edge>>& list, size_t node) {
+                return std::lower_bound(list.begin(), list.end(), std::make_pair(static_cast<NodeId>(node), Edge{0, 0}),
+                                        bySubject) - list.begin();
+            };
+            size_t a = position(added, first), r = position(removed, first);
+            std::vector<Edge>& out = partEdges[t];
+            for (size_t node = first; node < last; node++) {
+                const Edge* b = node < baseNodes ? base.edgesOf(static_cast<NodeId>(node)) : nullptr;
+                const Edge* bEnd = node < baseNodes ? b + base.degree(static_cast<NodeId>(node)) : nullptr;
+                size_t before = out.size();
+                bool touched = (a < added.size() && added[a].first == node) || 
+                               (r < removed.size() && removed[r].first == node);
+                if (!touched) {
+                    out.insert(out.end(), b, bEnd);
+                } else {
+                    // Both runs are sorted: drop removed edges from the base run and merge in the added ones
+                    for (;;) {
+                        while (b < bEnd && r < removed.size() && removed[r].first == node && removed[r].second < *b)
+                            r++;
+                        bool haveBase = b < bEnd;
+                        bool haveAdded = a < added.size() && added[a].first == node;
+                        if (!haveBase && !haveAdded)
+                            break;
+                        if (haveBase && r < removed.size() && removed[r].first == node && removed[r].second == *b) {
+                            b++;
+                        } else if (haveAdded && (!haveBase || added[a].second < *b)) {
+                            out.push_back(added[a++].second);
+                        } else {
+                            if (haveAdded && added[a].second == *b)
+                                a++;
+                            out.push_back(*b++);
+                        }
+                    }
+                    while (r < removed.size() && removed[r].first == node)
+                        r++;
+                }
+                degrees[node + 1] = out.size() - before;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    for (size_t i = 0; i < numNodes; i++)
+        degrees[i + 1] += degrees[i];
+    std::vector<Edge> edges;
+    edges.reserve(degrees.back());
+    for (auto& part : partEdges) {
+        edges.insert(edges.end(), part.begin(), part.end());
+        std::vector<Edge>().swap(part);
+    }
+    graph.offsets.assign(std::move(degrees));
+    graph.edges.assign(std::move(edges));
+    if (!predicateWeights.empty()) {
+        std::vector<float> weights(predicateWeights);
+        weights.resize(numNodes, 1.0f);
+        buildAliasTables(graph, weights, numThreads);
+    }
+    
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    std::clog << "[" << getCurrentTimestamp() << "] Merged " << added.size() << " added and " << removed.size() 
+              << " removed triples: " << graph.numNodes() << " nodes and " << graph.numEdges() << " edges (was " 
+              << base.numEdges() << ") in " << formatDuration(elapsed) << "\n";
+    return graph;
+}
+
+// Counter-based generator (Philox4x32-10). The output depends only on the
+// key (run seed) and the counter (start node, walk index, block), so every
+// walk has its own stream: it can be regenerated on its own and does not
+// depend on which thread produced it or in what order. The whole state is
+// a few words, against mt19937's 2.5 KB.
+class WalkRng {
+private:
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t output[4];
+    int position = 4;
+
+    static inline void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+        uint64_t product = static_cast<uint64_t>(a) * b;
+        hi = static_cast<uint32_t>(product >> 32);
+        lo = static_cast<uint32_t>(product);
+    }
+
+    void generate() {
+        uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57u, c[2], hi1, lo1);
+            c[0] = hi1 ^ c[1] ^ k0;
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k1;
+            c[3] = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        memcpy(output, c, sizeof(output));
+        counter[0]++;
+        position = 0;
+    }
+
+public:
+    using result_type = uint32_t;
+
+    WalkRng(uint64_t seed, uint64_t stream, uint32_t index)
+        : key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+          counter{0, index, static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)} {}
+
+    // Resume a stream at a point saved with blockCounter() and outputPosition()
+    WalkRng(uint64_t seed, uint64_t stream, uint32_t index, uint32_t block, int position)
+        : WalkRng(seed, stream, index) {
+        if (position < 4 && block > 0) {
+            counter[0] = block - 1;
+            generate();
+            this->position = position;
+        } else {
+            counter[0] = block;
+        }
+    }
+
+    uint32_t blockCounter() const { return counter[0]; }
+    int outputPosition() const { return position; }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+    result_type operator()() {
+        if (position == 4)
+            generate();
+        return output[position++];
+    }
+};
+
+// Number of IDs a walk over `length` entities occupies, counting the
+// predicates between consecutive entities
+inline size_t walkBufferSize(int length) {
+    return length > 1 ? 2 * static_cast<size_t>(length) - 1 : 1;
+}
+
+// Uniform integer in [0, range) from a single 32-bit draw in the common case
+// (Lemire's multiply-shift with rejection), instead of a modulo or a shuffle
+template <typename Rng>
+inline uint32_t boundedRandom(Rng& rng, uint32_t range) {
+    uint64_t m = static_cast<uint64_t>(static_cast<uint32_t>(rng())) * range;
+    uint32_t low = static_cast<uint32_t>(m);
+    if (low < range) {
+        uint32_t threshold = -range % range;
+        while (low < threshold) {
+            m = static_cast<uint64_t>(static_cast<uint32_t>(rng())) * range;
+            low = static_cast<uint32_t>(m);
+        }
+    }
+    return static_cast<uint32_t>(m >> 32);
+}
+
+// Pick an out-edge of node in O(1): uniformly, or through the node's alias
+// table when the graph carries predicate weights. Returns kNoEdge if the node
+// has no edge that can be taken.
+template <typename Rng>
+inline uint32_t sampleEdge(const Graph& graph, NodeId node, Rng& rng) {
+    size_t degree = graph.degree(node);
+    if (degree == 0)
+        return kNoEdge;
+    uint32_t choice = boundedRandom(rng, static_cast<uint32_t>(degree));
+    if (graph.weighted()) {
+        uint64_t slot = graph.offsets[node] + choice;
+        if (static_cast<uint32_t>(rng()) >= graph.aliasThreshold[slot])
+            choice = graph.aliasIndex[slot];
+    }
+    return choice;
+}
+
+// Walk of up to `length` entities from start, picking each out-edge uniformly
+// or by predicate weight. Writes entity, predicate, entity, ... into out,
+// which must hold walkBufferSize(length) IDs, and returns the number of IDs
+// written. Each hop is O(1) and the kernel never allocates.
+template <typename Rng>
+size_t randomWalk(const Graph& graph, NodeId start, int length, Rng& rng, NodeId* out) {
+    size_t n = 0;
+    out[n++] = start;
+    NodeId current = start;
+    for (int i = 0; i < length - 1; i++) {  // -1 because we already have the start node
+        uint32_t choice = sampleEdge(graph, current, rng);
+        if (choice == kNoEdge)
+            break;
+        const Edge& edge = graph.edgesOf(current)[choice];
+        out[n++] = edge.predicate;
+        out[n++] = edge.target;
+        current = edge.target;
+    }
+    return n;
+}
+
+// node2vec return parameter p and in-out parameter q. The step from v (having
+// come from t) to x is weighted 1/p if x == t, 1 if t links to x and 1/q
+// otherwise, on top of any predicate weight. The bounds are those weights
+// divided by their maximum and scaled to 32 bits, for rejection sampling;
+// they are at least 1, so no kind of step is ruled out entirely.
+struct WalkBias {
+    double p = 1.0;
+    double q = 1.0;
+    uint64_t returnBound = 1ULL << 32;
+    uint64_t neighborBound = 1ULL << 32;
+    uint64_t outBound = 1ULL << 32;
+    uint64_t lowerBound = 1ULL << 32;   // smallest of the three
+
+    bool secondOrder() const { return p != 1.0 || q != 1.0; }
+};
+
+// Usable p or q: positive, and with a finite weight 1/value (a denormal p
+// would make the weights infinite and the bounds NaN)
+inline bool validWalkBiasParam(double value) {
+    return value > 0 && std::isfinite(1.0 / value);
+}
+
+WalkBias makeWalkBias(double p, double q) {
+    WalkBias bias;
+    bias.p = p;
+    bias.q = q;
+    double maxWeight = std::max({1.0 / p, 1.0, 1.0 / q});
+    auto scale = [&](double weight) {
+        return std::max<uint64_t>(1, static_cast<uint64_t>(std::ldexp(weight / maxWeight, 32)));
+    };
+    bias.returnBound = scale(1.0 / p);
+    bias.neighborBound = scale(1.0);
+    bias.outBound = scale(1.0 / q);
+    bias.lowerBound = std::min({bias.returnBound, bias.neighborBound, bias.outBound});
+    return bias;
+}
+
+// Whether node has an edge to target; edges of a node are sorted by target
+inline bool hasEdgeTo(const Graph& graph, NodeId node, NodeId target) {
+    const Edge* begin = graph.edgesOf(node);
+    const Edge* end = begin + graph.degree(node);
+    const Edge* it = std::lower_bound(begin, end, target, 
+                                      [](const Edge& edge, NodeId value) { return edge.target < value; });
+    return it != end && it->target == target;
+}
+
+// Second-order walk by rejection sampling: propose an edge as the first-order
+// kernel would and accept it with its node2vec weight relative to the
+// largest one. The neighbour test is a binary search in the previous node's
+// edges, and is skipped when the draw is accepted under any outcome, so no
+// second-order tables are built and memory stays O(E). A step takes its
+// kMaxNode2vecProposals-th proposal as it is, which bounds the work when
+// extreme p or q leave only edges of a nearly impossible kind.
+const int kMaxNode2vecProposals = 1000;
+
+template <typename Rng>
+size_t node2vecWalk(const Graph& graph, NodeId start, int length, const WalkBias& bias, Rng& rng, NodeId* out) {
+    size_t n = 0;
+    out[n++] = start;
+    NodeId previous = kInvalidNode;
+    NodeId current = start;
+    for (int i = 0; i < length - 1; i++) {
+        const Edge* edge;
+        for (int proposals = 1; ; proposals++) {
+            uint32_t choice = sampleEdge(graph, current, rng);
+            if (choice == kNoEdge)
+                return n;
+            edge = graph.edgesOf(current) + choice;
+            if (previous == kInvalidNode)
+                break;
+            uint32_t draw = static_cast<uint32_t>(rng());
+            if (draw < bias.lowerBound)
+                break;
+            uint64_t bound = edge->target == previous ? bias.returnBound 
+                           : hasEdgeTo(graph, previous, edge->target) ? bias.neighborBound : bias.outBound;
+            if (draw < bound || proposals == kMaxNode2vecProposals)
+                break;
+        }
+        out[n++] = edge->predicate;
+        out[n++] = edge->target;
+        previous = current;
+        current = edge->target;
+    }
+    return n;
+}
+
+template <typename Rng>
+inline size_t randomWalk(const Graph& graph, NodeId start, int length, const WalkBias& bias, Rng& rng, NodeId* out) {
+    return bias.secondOrder() ? node2vecWalk(graph, start, length, bias, rng, out) 
+                              : randomWalk(graph, start, length, rng, out);
+}
+
+// Number of walks randomWalkBatch advances together
+const size_t kWalkBatchSize = 64;
+
+inline void prefetchRead(const void* address) {
+    __builtin_prefetch(address, 0, 3);
+}
+
+// First-order walks from many start nodes at once. On a graph much larger
+// than the cache every hop of randomWalk is two dependent misses (the node's
+// offsets, then the chosen edge), and one walk at a time leaves the core
+// waiting on each. Here up to kWalkBatchSize walks advance in lockstep, two
+// passes per hop: the first picks every walk's edge and prefetches it, the
+// second takes the edges and prefetches the next nodes' offsets, so each miss
+// is overlapped with the work on the other walks. Walk l starts at starts[l]
+// with lengths[l] entities and draws from rngs[l] exactly as randomWalk
+// would, so it is the same walk; it is written to ids + l * stride, and
+// sizes[l] receives its number of IDs.
+template <typename Rng>
+void randomWalkBatch(const Graph& graph, size_t count, const NodeId* starts, const int* lengths, Rng* rngs, 
+                     NodeId* ids, size_t stride, uint32_t* sizes) {
+    const uint64_t* offsets = graph.offsets.data();
+    const Edge* edges = graph.edges.data();
+    bool weighted = graph.weighted();
+    
+    // Per-walk state as parallel arrays; `lanes` lists the walks still going
+    uint32_t lanes[kWalkBatchSize];
+    NodeId current[kWalkBatchSize];
+    uint64_t rowBegin[kWalkBatchSize];
+    uint64_t slot[kWalkBatchSize];
+    int remaining[kWalkBatchSize];
+    size_t numActive = 0;
+    for (size_t l = 0; l < count; l++) {
+        ids[l * stride] = starts[l];
+        sizes[l] = 1;
+        current[l] = starts[l];
+        remaining[l] = lengths[l] - 1;
+        if (remaining[l] > 0) {
+            prefetchRead(offsets + starts[l]);
+            lanes[numActive++] = static_cast<uint32_t>(l);
+        }
+    }
+    
+    while (numActive > 0) {
+        // Pick each walk's out-edge (sampleEdge's draws, in the same order)
+        size_t kept = 0;
+        for (size_t a = 0; a < numActive; a++) {
+            uint32_t l = lanes[a];
+            uint64_t begin = offsets[current[l]];
+            uint64_t degree = offsets[current[l] + 1] - begin;
+            if (degree == 0)
+                continue;
+            rowBegin[l] = begin;
+            slot[l] = begin + boundedRandom(rngs[l], static_cast<uint32_t>(degree));
+            prefetchRead(edges + slot[l]);
+            if (weighted) {
+                prefetchRead(graph.aliasThreshold.data() + slot[l]);
+                prefetchRead(graph.aliasIndex.data() + slot[l]);
+            }
+            lanes[kept++] = l;
+        }
+        numActive = kept;
+        
+        // Take the edges and start fetching where the walks go next
+        kept = 0;
+        for (size_t a = 0; a < numActive; a++) {
+            uint32_t l = lanes[a];
+            uint64_t taken = slot[l];
+            if (weighted && static_cast<uint32_t>(rngs[l]()) >= graph.aliasThreshold[taken]) {
+                uint32_t alias = graph.aliasIndex[taken];
+                if (alias == kNoEdge)
+                    continue;
+                taken = rowBegin[l] + alias;
+            }
+            const Edge& edge = edges[taken];
+            NodeId* out = ids + l * stride + sizes[l];
+            out[0] = edge.predicate;
+            out[1] = edge.target;
+            sizes[l] += 2;
+            current[l] = edge.target;
+            if (--remaining[l] > 0) {
+                prefetchRead(offsets + edge.target);
+                lanes[kept++] = l;
+            }
+        }
+        numActive = kept;
+    }
+}
+
+Walk randomWalk(const Graph& graph, NodeId start, int length, std::mt19937& rng, const WalkBias& bias = WalkBias()) {
+    Walk walk(walkBufferSize(length));
+    walk.resize(randomWalk(graph, start, length, bias, rng, walk.data()));
+    return walk;
+}
+
+// Previous kernel, kept as the baseline for benchmarkWalkKernels: it builds and
+// shuffles a vector of every out-edge index on each hop
+Walk shuffleRandomWalk(const Graph& graph, NodeId start, int length, std::mt19937& rng) {
+    Walk walk{start};
+    NodeId current = start;
+    
+    // For tracking choices made at each step to allow backtracking
+    std::vector<std::pair<int, std::vector<int>>> choicesHistory;
+    
+    // Walk length now refers to number of entities (excluding predicates)
+    // We'll add predicates in between, so the final path length could be up to 2*length - 1
+    for (int i = 0; i < length - 1; i++) {  // -1 because we already have the start node
+        size_t degree = graph.degree(current);
+        if (degree == 0)
+            break;
+            
+        const Edge* edges = graph.edgesOf(current);
+        
+        // Record all possible choices at this step
+        std::vector<int> availableChoices;
+        for (int j = 0; j < static_cast<int>(degree); j++) {
+            availableChoices.push_back(j);
+        }
+        
+        // If only one option, no need to shuffle
+        if (availableChoices.size() > 1) {
+            std::shuffle(availableChoices.begin(), availableChoices.end(), rng);
+        }
+        
+        // Select the first available choice
+        int edgeIndex = availableChoices[0];
+        
+        // Store the choice made and remaining options for potential backtracking
+        choicesHistory.push_back({edgeIndex, availableChoices});
+        
+        // Add both predicate and target to the walk
+        walk.push_back(edges[edgeIndex].predicate);
+        walk.push_back(edges[edgeIndex].target);
+        
+        current = edges[edgeIndex].target;
+    }
+    
+    return walk;
+}
+
+// Open-addressing set of 64-bit walk hashes (0 marks an empty slot). clear()
+// keeps the table, so one set serves every start node of a worker.
+class WalkHashSet {
+private:
+    std::vector<uint64_t> slots;
+    size_t count = 0;
+
+    void grow() {
+        std::vector<uint64_t> old(std::max<size_t>(64, slots.size() * 2), 0);
+        old.swap(slots);
+        count = 0;
+        for (uint64_t hash : old) {
+            if (hash != 0)
+                insert(hash);
+        }
+    }
+
+public:
+    // Returns false if the hash was already present
+    bool insert(uint64_t hash) {
+        if (hash == 0)
+            hash = 1;
+        if (2 * (count + 1) > slots.size())
+            grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            if (slots[i] == hash)
+                return false;
+            if (slots[i] == 0) {
+                slots[i] = hash;
+                count++;
+                return true;
+            }
+        }
+    }
+
+    void clear() {
+        if (count > 0)
+            std::fill(slots.begin(), slots.end(), 0);
+        count = 0;
+    }
+};
+
+// Walks from one start node stored back to back: walk i is
+// ids[ends[i - 1] .. ends[i]). Reused across start nodes, along with the
+// generators of the attempts in flight.
+struct WalkBatch {
+    std::vector<NodeId> ids;
+    std::vector<size_t> ends;
+    std::vector<WalkRng> rngs;
+
+    size_t size() const { return ends.size(); }
+    const NodeId* walk(size_t i) const { return ids.data() + (i == 0 ? 0 : ends[i - 1]); }
+    size_t walkSize(size_t i) const { return ends[i] - (i == 0 ? 0 : ends[i - 1]); }
+    void clear() {
+        ids.clear();
+        ends.clear();
+    }
+};
+
+// Which out-edges of node the sampler can ever take: all of them, or with
+// alias tables those kept by their own slot or named as another slot's alias
+// (an edge whose predicate weighs 0 is neither)
+void takeableEdges(const Graph& graph, NodeId node, std::vector<char>& takeable) {
+    size_t degree = graph.degree(node);
+    takeable.assign(degree, !graph.weighted());
+    if (!graph.weighted())
+        return;
+    uint64_t offset = graph.offsets[node];
+    for (size_t j = 0; j < degree; j++) {
+        uint32_t threshold = graph.aliasThreshold[offset + j];
+        uint32_t alias = graph.aliasIndex[offset + j];
+        if (threshold > 0)
+            takeable[j] = 1;
+        if (threshold < std::numeric_limits<uint32_t>::max() && alias != kNoEdge)
+            takeable[alias] = 1;
+    }
+}
+
+// Number of distinct walks of up to `length` entities from node, counting at
+// most `limit`. Walks are counted forwards a step at a time: the frontier maps
+// each node to the number of distinct walk prefixes ending there, and a prefix
+// at a node with nothing to follow is a finished walk. Every prefix extends to
+// at least one walk, so the count stops as soon as finished and pending
+// prefixes reach the limit; the frontier never holds more than `limit` nodes,
+// and nothing recurses, whatever the length. Parallel edges (same predicate
+// and target, adjacent after sorting) count once, and edges the sampler can
+// never take not at all.
+size_t countDistinctWalks(const Graph& graph, NodeId node, int length, size_t limit) {
+    if (limit == 0)
+        return 0;
+    auto add = [limit](size_t a, size_t b) { return b >= limit - std::min(a, limit) ? limit : a + b; };
+    std::unordered_map<NodeId, size_t> frontier{{node, 1}}, next;
+    std::vector<char> takeable;
+    size_t finished = 0;
+    for (int step = 1; step < length && !frontier.empty(); step++) {
+        size_t unexpanded = 0;
+        for (const auto& entry : frontier)
+            unexpanded = add(unexpanded, entry.second);
+        size_t pending = 0;
+        next.clear();
+        for (const auto& entry : frontier) {
+            NodeId current = entry.first;
+            size_t prefixes = entry.second;
+            unexpanded -= std::min(unexpanded, prefixes);
+            const Edge* edges = graph.edgesOf(current);
+            takeableEdges(graph, current, takeable);
+            const Edge* counted = nullptr;
+            for (size_t j = 0; j < takeable.size(); j++) {
+                if (!takeable[j] || (counted && edges[j] == *counted))
+                    continue;
+                counted = edges + j;
+                size_t& slot = next[edges[j].target];
+                slot = add(slot, prefixes);
+                pending = add(pending, prefixes);
+                if (add(add(finished, pending), unexpanded) >= limit)
+                    return limit;
+            }
+            if (!counted)
+                finished = add(finished, prefixes);
+            if (add(add(finished, pending), unexpanded) >= limit)
+                return limit;
+        }
+        frontier.swap(next);
+    }
+    for (const auto& entry : frontier)
+        finished = add(finished, entry.second);
+    return finished;
+}
+
+// Generate up to numWalks distinct walks from startNode into batch. Walks are
+// compared by a 64-bit hash of their ID sequence, taken while the buffer is
+// still in cache, in a flat set the caller reuses across nodes. Nodes that
+// cannot reach numWalks distinct walks stop as soon as they have all of them.
+// Attempt i uses the stream (seed, startNode, i), so the result depends only
+// on the seed. First-order attempts run through randomWalkBatch, as many at a
+// time as are still needed (and at most kWalkBatchSize), so no attempt is
+// wasted and the walks are those of one attempt at a time.
+size_t generateDistinctWalks(const Graph& graph, NodeId startNode, int numWalks, int walkLength, 
+                             uint64_t seed, const WalkBias& bias, WalkHashSet& seen, WalkBatch& batch) {
+    batch.clear();
+    seen.clear();
+    if (numWalks <= 0 || walkLength <= 0)
+        return 0;
+    size_t available = countDistinctWalks(graph, startNode, walkLength, numWalks);
+    size_t target = std::min<size_t>(numWalks, available);
+    size_t bufferSize = walkBufferSize(walkLength);
+    
     int attempts = 0;
     int duplicates = 0;
     const int maxAttemptsPerWalk = 10; // Maximum tries to generate a unique walk
+    const int maxAttempts = numWalks * maxAttemptsPerWalk;
+    NodeId starts[kWalkBatchSize];
+    int lengths[kWalkBatchSize];
+    uint32_t sizes[kWalkBatchSize];
+    size_t pending = 0;     // attempts generated but not yet checked
+    size_t next = 0;        // the next of them to check
+    size_t pendingBegin = 0;
+    
+    while (batch.size() < target && attempts < maxAttempts) {
+        if (next == pending) {
+            // Generate the next group of attempts past the accepted walks
+            pending = bias.secondOrder() ? 1 : std::min({kWalkBatchSize, target - batch.size(), 
+                                                         static_cast<size_t>(maxAttempts - attempts)});
+            next = 0;
+            pendingBegin = batch.size() == 0 ? 0 : batch.ends.back();
+            batch.ids.resize(pendingBegin + pending * bufferSize);
+            batch.rngs.clear();
+            for (size_t b = 0; b < pending; b++) {
+                starts[b] = startNode;
+                lengths[b] = walkLength;
+                batch.rngs.emplace_back(seed, startNode, static_cast<uint32_t>(attempts + b));
+            }
+            if (pending > 1)
+                randomWalkBatch(graph, pending, starts, lengths, batch.rngs.data(), batch.ids.data() + pendingBegin, 
+                                bufferSize, sizes);
+            else
+                sizes[0] = static_cast<uint32_t>(randomWalk(graph, startNode, walkLength, bias, batch.rngs[0], 
+                                                            batch.ids.data() + pendingBegin));
+        }
+        
+        // Move the attempt down to the end of the accepted walks
+        size_t begin = batch.size() == 0 ? 0 : batch.ends.back();
+        size_t walkSize = sizes[next];
+        memmove(batch.ids.data() + begin, batch.ids.data() + pendingBegin + next * bufferSize, 
+                walkSize * sizeof(NodeId));
+        next++;
+        uint64_t hash = hashBytes(reinterpret_cast<const char*>(batch.ids.data() + begin), walkSize * sizeof(NodeId));
+        
+        attempts++;
+        
+        // Check if this walk is already generated
+        if (seen.insert(hash)) {
+            batch.ends.push_back(begin + walkSize);
+            continue;
+        }
+        
+        // Duplicate walk found
+        duplicates++;
+        
+        // If we have too many duplicates, the remaining paths are rare under
+        // the sampling weights
+        if (duplicates > numWalks * 2) {
+            std::clog << "[" << getCurrentTimestamp() << "] WARNING: High number of duplicate walks from node " 
+                      << graph.dict.name(startNode) << ". Possibly limited path diversity.\n";
+            
+            // Accept some duplicates if we can't find enough unique walks
+            if (batch.size() < static_cast<size_t>(numWalks) / 2) {
+                batch.ends.push_back(begin + walkSize);
+                std::clog << "[" << getCurrentTimestamp() << "] Accepting some duplicate walks to meet quota.\n";
+                continue;
+            }
+        }
+        
+        // Log progress for excessive attempts
+        if (attempts % (numWalks * 2) == 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] Generated " << batch.size() 
+                      << " unique walks after " << attempts << " attempts. Duplicates: " << duplicates << "\n";
+        }
+    }
+    
+    batch.ids.resize(batch.size() == 0 ? 0 : batch.ends.back());
+    if (batch.size() < target) {
+        std::clog << "[" << getCurrentTimestamp() << "] Could only generate " << batch.size() 
+                  << " unique walks out of " << numWalks << " requested from node " << graph.dict.name(startNode) << "\n";
+    }
+    
+    return batch.size();
+}
+
+
+// Bounded lock-free multi-producer/multi-consumer queue (Vyukov's array
+// queue). Capacity must be a power of two.
+template <typename T>
+class BoundedQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+
+public:
+    explicit BoundedQueue(size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool tryPush(const T& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->value;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// Spin briefly, then yield, then sleep while waiting on a queue
+inline void backoff(int& idleRounds) {
+    if (idleRounds < 64) {
+        idleRounds++;
+    } else if (idleRounds < 128) {
+        idleRounds++;
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+struct OutputChunk {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+    size_t capacity = 0;
+    // Position in the output for ordered writers: part `part` of the task
+    // covering start nodes [begin, end), `last` on the task's final chunk
+    size_t begin = 0;
+    size_t end = 0;
+    uint32_t part = 0;
+    bool last = false;
+};
+
+// Dedicated writer thread fed through lock-free queues. Workers fill
+// preallocated chunks and submit them; the writer issues one large write()
+// per chunk and recycles it, so no worker ever waits on a mutex or the disk.
+// An ordered writer holds chunks back until every earlier task is written,
+// so the file lists walks in start-node order whatever the thread count or
+// stealing order; its workers allocate extra chunks instead of waiting for
+// ones the writer is holding. What it holds stays bounded because the
+// scheduler only hands out tasks close to written() (see orderedTaskLimit).
+class WalkWriter {
+private:
+    int fd;
+    bool ordered;
+    size_t chunkSize;
+    std::vector<std::unique_ptr<OutputChunk>> chunks;
+    std::mutex chunksMutex;             // ordered writers grow chunks from several workers
+    BoundedQueue<OutputChunk*> freeChunks;
+    BoundedQueue<OutputChunk*> filledChunks;
+    std::atomic<bool> done{false};
+    std::atomic<bool> failed{false};
+    std::atomic<size_t> bytesWritten{0};
+    std::atomic<size_t> writtenEnd{0};  // ordered writers: items before this are all written
+    std::thread writer;
+
+    static size_t queueCapacity(size_t numChunks) {
+        size_t capacity = 1;
+        while (capacity < numChunks)
+            capacity <<= 1;
+        return capacity;
+    }
+
+    void writeChunk(const OutputChunk& chunk) {
+        PhaseTimer timer(kPhaseWrite);
+        size_t written = 0;
+        while (written < chunk.size && !failed.load(std::memory_order_relaxed)) {
+            ssize_t n = ::write(fd, chunk.data.get() + written, chunk.size - written);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::clog << "[" << getCurrentTimestamp() << "] Error writing walks: " << strerror(errno) << "\n";
+                failed = true;
+                return;
+            }
+            written += n;
+        }
+        bytesWritten.fetch_add(written, std::memory_order_relaxed);
+        if (gMetricsEnabled)
+            threadMetrics().add(kCounterBytesWritten, written);
+    }
+
+    void recycle(OutputChunk* chunk) {
+        chunk->size = 0;
+        // A full free queue only happens after ordered growth; the chunk stays owned by `chunks`
+        freeChunks.tryPush(chunk);
+    }
+
+    void run() {
+        int idleRounds = 0;
+        OutputChunk* chunk;
+        std::map<std::pair<size_t, uint32_t>, OutputChunk*> heldBack;
+        size_t nextBegin = 0;
+        uint32_t nextPart = 0;
+        for (;;) {
+            if (filledChunks.tryPop(chunk)) {
+                idleRounds = 0;
+                if (!ordered) {
+                    writeChunk(*chunk);
+                    recycle(chunk);
+                    continue;
+                }
+                heldBack[{chunk->begin, chunk->part}] = chunk;
+                while (!heldBack.empty() && heldBack.begin()->first == std::make_pair(nextBegin, nextPart)) {
+                    chunk = heldBack.begin()->second;
+                    heldBack.erase(heldBack.begin());
+                    writeChunk(*chunk);
+                    if (chunk->last) {
+                        nextBegin = chunk->end;
+                        nextPart = 0;
+                        writtenEnd.store(nextBegin, std::memory_order_release);
+                    } else {
+                        nextPart++;
+                    }
+                    recycle(chunk);
+                }
+            } else if (done.load(std::memory_order_acquire)) {
+                // All producers have submitted; drain whatever is left
+                while (filledChunks.tryPop(chunk))
+                    heldBack[{chunk->begin, chunk->part}] = chunk;
+                for (const auto& held : heldBack)
+                    writeChunk(*held.second);
+                return;
+            } else {
+                backoff(idleRounds);
+            }
+        }
+    }
+
+public:
+    WalkWriter(int fd, size_t numChunks, size_t chunkSize, bool ordered = false)
+        : fd(fd), ordered(ordered), chunkSize(chunkSize), 
+          freeChunks(queueCapacity(numChunks)), filledChunks(queueCapacity(numChunks)) {
+        for (size_t i = 0; i < numChunks; i++) {
+            auto chunk = std::make_unique<OutputChunk>();
+            chunk->data.reset(new char[chunkSize]);
+            chunk->capacity = chunkSize;
+            freeChunks.tryPush(chunk.get());
+            chunks.push_back(std::move(chunk));
+        }
+        writer = std::thread(&WalkWriter::run, this);
+    }
+
+    ~WalkWriter() { finish(); }
+
+    bool isOrdered() const { return ordered; }
+
+    OutputChunk* acquire() {
+        OutputChunk* chunk;
+        int idleRounds = 0;
+        while (!freeChunks.tryPop(chunk)) {
+            if (ordered) {
+                std::lock_guard<std::mutex> lock(chunksMutex);
+                chunks.push_back(std::make_unique<OutputChunk>());
+                chunks.back()->data.reset(new char[chunkSize]);
+                chunks.back()->capacity = chunkSize;
+                return chunks.back().get();
+            }
+            backoff(idleRounds);
+        }
+        return chunk;
+    }
+
+    void submit(OutputChunk* chunk) {
+        // Only an ordered writer can have more chunks than the queue holds
+        int idleRounds = 0;
+        while (!filledChunks.tryPush(chunk))
+            backoff(idleRounds);
+    }
+
+    // Hand back an unused chunk from acquire()
+    void release(OutputChunk* chunk) { recycle(chunk); }
+
+    // Ordered writers: every task ending at or before this position is written
+    size_t written() const { return writtenEnd.load(std::memory_order_acquire); }
+
+    // Call once all producers are done
+    void finish() {
+        if (writer.joinable()) {
+            done.store(true, std::memory_order_release);
+            writer.join();
+        }
+    }
+
+    bool ok() const { return !failed.load(); }
+    size_t bytes() const { return bytesWritten.load(); }
+};
+
+// Tasks per worker that an ordered run may start past the first one not yet written
+const size_t kReorderWindowTasksPerThread = 8;
+
+// Scheduler limit for writer: none for unordered writers, and for ordered
+// ones the window past written() where tasks may start
+std::function<size_t()> orderedTaskLimit(const WalkWriter& writer, size_t grainSize, int numThreads) {
+    if (!writer.isOrdered())
+        return nullptr;
+    size_t window = kReorderWindowTasksPerThread * numThreads * grainSize;
+    return [&writer, window]() { return writer.written() + window; };
+}
+
+// Per-worker handle on a WalkWriter: formats walks straight into the current
+// chunk and submits it when the next walk would not fit. A chunk is only
+// taken from the writer when there is something to put in it, so an idle
+// emitter holds none.
+class WalkEmitter {
+private:
+    WalkWriter& writer;
+    OutputChunk* chunk = nullptr;
+    size_t taskBegin = 0;
+    size_t taskEnd = 0;
+    uint32_t taskPart = 0;
+
+    void submitChunk(bool last) {
+        chunk->begin = taskBegin;
+        chunk->end = taskEnd;
+        chunk->part = taskPart++;
+        chunk->last = last;
+        writer.submit(chunk);
+        chunk = nullptr;
+    }
+
+public:
+    explicit WalkEmitter(WalkWriter& writer) : writer(writer) {}
+
+    ~WalkEmitter() { flush(); }
+
+    // Returns space for n bytes; commit() the bytes actually used
+    char* reserve(size_t n) {
+        if (chunk && chunk->size + n > chunk->capacity)
+            flush();
+        if (!chunk) {
+            chunk = writer.acquire();
+            if (n > chunk->capacity) {
+                // A walk larger than a whole chunk (very long literals): grow this one
+                chunk->data.reset(new char[n]);
+                chunk->capacity = n;
+            }
+        }
+        return chunk->data.get() + chunk->size;
+    }
+
+    void commit(size_t n) { chunk->size += n; }
+
+    // Ordered writers need every task to end in its own chunk, even an empty one
+    void beginTask(size_t begin, size_t end) {
+        taskBegin = begin;
+        taskEnd = end;
+        taskPart = 0;
+    }
+
+    void endTask() {
+        if (writer.isOrdered()) {
+            if (!chunk)
+                chunk = writer.acquire();
+            submitChunk(true);
+        }
+    }
+
+    // Submit the current chunk, or hand it back if it is empty
+    void flush() {
+        if (chunk && chunk->size > 0) {
+            submitChunk(false);
+        } else if (chunk) {
+            writer.release(chunk);
+            chunk = nullptr;
+        }
+    }
+};
+
+// Bytes of a walk as comma-separated terms plus one terminating character
+inline size_t walkCSVLength(const Graph& graph, const NodeId* walk, size_t walkSize) {
+    size_t length = walkSize;  // separators and the terminator
+    for (size_t i = 0; i < walkSize; i++)
+        length += graph.dict.outputName(walk[i]).size();
+    return length;
+}
+
+inline char* copyWalkCSV(char* p, const Graph& graph, const NodeId* walk, size_t walkSize, char terminator) {
+    for (size_t i = 0; i < walkSize; i++) {
+        p = graph.dict.outputName(walk[i]).copyTo(p);
+        *p++ = (i + 1 < walkSize) ? ',' : terminator;
+    }
+    return p;
+}
+
+// Append a walk as one CSV line of term strings
+void emitWalkCSV(WalkEmitter& out, const Graph& graph, const NodeId* walk, size_t walkSize) {
+    size_t length = walkCSVLength(graph, walk, walkSize);
+    copyWalkCSV(out.reserve(length), graph, walk, walkSize, '\n');
+    out.commit(length);
+}
+
+enum WalkFormat {
+    kFormatCsv,
+    kFormatBinary,
+    kFormatText,
+    kFormatTokens
+};
+
+// Binary walk files start with this header and then hold one record per walk:
+// a uint32 ID count followed by that many uint32 IDs (entity, predicate,
+// entity, ...). IDs refer to a sidecar dictionary file with one term per
+// line, line i holding the term with ID i; the header records its checksum.
+const char kWalkFileMagic[8] = {'R', 'W', 'W', 'A', 'L', 'K', 'S', '\0'};
+const uint32_t kWalkFileVersion = 1;
+
+struct WalkFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t numTerms;
+    uint64_t dictionaryChecksum;  // hashBytes over the whole sidecar file, 0 if unknown
+};
+
+WalkFileHeader makeWalkFileHeader(uint64_t numTerms, uint64_t dictionaryChecksum) {
+    WalkFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kWalkFileMagic, sizeof(header.magic));
+    header.version = kWalkFileVersion;
+    header.byteOrder = kSnapshotByteOrder;
+    header.numTerms = numTerms;
+    header.dictionaryChecksum = dictionaryChecksum;
+    return header;
+}
+
+// Append a walk as a length-prefixed record of uint32 IDs
+void emitWalkBinary(WalkEmitter& out, const NodeId* walk, size_t walkSize) {
+    uint32_t count = static_cast<uint32_t>(walkSize);
+    size_t length = sizeof(count) + walkSize * sizeof(NodeId);
+    char* p = out.reserve(length);
+    memcpy(p, &count, sizeof(count));
+    memcpy(p + sizeof(count), walk, walkSize * sizeof(NodeId));
+    out.commit(length);
+}
+
+// Append a walk in the format random_walk.sh gets from Fuseki:
+// "2025-03-23T10:15:00 RANDOM WALK (length=N): a -> b -> c", with the
+// entities only and N the length the walk was drawn with (a walk that hits
+// a dead end is shorter). The timestamp is formatted once per second per thread.
+void emitWalkText(WalkEmitter& out, const Graph& graph, const NodeId* walk, size_t walkSize, int length) {
+    thread_local time_t stampTime = 0;
+    thread_local char stamp[32];
+    time_t now = time(nullptr);
+    if (now != stampTime) {
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &local);
+        stampTime = now;
+    }
+    char prefix[96];
+    int prefixLength = snprintf(prefix, sizeof(prefix), "%s RANDOM WALK (length=%d): ", stamp, length);
+
+    static const char kArrow[] = " -> ";
+    size_t total = prefixLength + 1;
+    for (size_t i = 0; i < walkSize; i += 2)
+        total += graph.dict.outputName(walk[i]).size() + (i > 0 ? sizeof(kArrow) - 1 : 0);
+
+    char* p = out.reserve(total);
+    memcpy(p, prefix, prefixLength);
+    p += prefixLength;
+    for (size_t i = 0; i < walkSize; i += 2) {
+        if (i > 0) {
+            memcpy(p, kArrow, sizeof(kArrow) - 1);
+            p += sizeof(kArrow) - 1;
+        }
+        p = graph.dict.outputName(walk[i]).copyTo(p);
+    }
+    *p = '\n';
+    out.commit(total);
+}
+
+// `length` is the walk's target length, only shown by the text format
+inline void emitWalk(WalkEmitter& out, WalkFormat format, const Graph& graph, const NodeId* walk, size_t walkSize,
+                     int length = 0) {
+    if (format == kFormatBinary)
+        emitWalkBinary(out, walk, walkSize);
+    else if (format == kFormatText)
+        emitWalkText(out, graph, walk, walkSize, length ? length : static_cast<int>((walkSize + 1) / 2));
+    else
+        emitWalkCSV(out, graph, walk, walkSize);
+}
+
+// Write the sidecar dictionary for binary walk files and return its checksum
+// through `checksum`
+bool writeDictionaryFile(const Graph& graph, const std::string& filename, uint64_t& checksum) {
+    {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error opening dictionary file: " << filename << "\n";
+            return false;
+        }
+        for (NodeId id = 0; id < graph.dict.size(); id++) {
+            TermParts name = graph.dict.name(id);
+            out.write(name.prefix.data(), name.prefix.size());
+            out.write(name.local.data(), name.local.size());
+            out.write(name.suffix.data(), name.suffix.size());
+            out.put('\n');
+        }
+        if (!out) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error writing dictionary file: " << filename << "\n";
+            return false;
+        }
+    }
+    MappedFile written;
+    if (!written.open(filename))
+        return false;
+    checksum = hashBytes(written.data(), written.size());
+    std::clog << "[" << getCurrentTimestamp() << "] Wrote " << graph.dict.size() << " terms to dictionary file " 
+              << filename << " (" << formatBytes(written.size()) << ")\n";
+    return true;
+}
+
+// Streaming reader for binary walk files; reads one record at a time and
+// checks every record's length against what is left of the file before
+// allocating for it
+class BinaryWalkReader {
+private:
+    std::ifstream in;
+    WalkFileHeader header;
+    uint64_t remaining = 0;         // bytes after the current position
+    bool corrupt = false;
+
+public:
+    bool open(const std::string& filename) {
+        in.open(filename, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error opening walk file: " << filename << "\n";
+            return false;
+        }
+        remaining = static_cast<uint64_t>(in.tellg());
+        in.seekg(0);
+        if (remaining < sizeof(header) || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            memcmp(header.magic, kWalkFileMagic, sizeof(header.magic)) != 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] Not a binary walk file: " << filename << "\n";
+            return false;
+        }
+        if (header.version != kWalkFileVersion || header.byteOrder != kSnapshotByteOrder) {
+            std::clog << "[" << getCurrentTimestamp() << "] Unsupported walk file version " << header.version << "\n";
+            return false;
+        }
+        remaining -= sizeof(header);
+        return true;
+    }
+
+    const WalkFileHeader& fileHeader() const { return header; }
+
+    // Returns false at the end of the file, or on a damaged record (see damaged())
+    bool next(Walk& walk) {
+        uint32_t count;
+        if (remaining == 0)
+            return false;
+        if (remaining < sizeof(count) || !in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+            corrupt = true;
+            return false;
+        }
+        remaining -= sizeof(count);
+        if (count == 0 || count > remaining / sizeof(NodeId)) {
+            corrupt = true;
+            return false;
+        }
+        walk.resize(count);
+        if (!in.read(reinterpret_cast<char*>(walk.data()), count * sizeof(NodeId))) {
+            corrupt = true;
+            return false;
+        }
+        remaining -= count * sizeof(NodeId);
+        return true;
+    }
+
+    // Whether reading stopped at a truncated or corrupt record rather than the end of the file
+    bool damaged() const { return corrupt; }
+};
+
+// Convert a binary walk file back to the CSV format, using its sidecar
+// dictionary. Writes to stdout when outputFile is "-".
+bool decodeWalkFile(const std::string& inputFile, const std::string& dictionaryFile, const std::string& outputFile) {
+    BinaryWalkReader reader;
+    if (!reader.open(inputFile))
+        return false;
+
+    MappedFile dictionary;
+    if (!dictionary.open(dictionaryFile)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening dictionary file: " << dictionaryFile << "\n";
+        return false;
+    }
+    // Streams from a server without a sidecar dictionary carry no checksum
+    uint64_t expectedChecksum = reader.fileHeader().dictionaryChecksum;
+    if (expectedChecksum != 0 && hashBytes(dictionary.data(), dictionary.size()) != expectedChecksum) {
+        std::clog << "[" << getCurrentTimestamp() << "] Dictionary " << dictionaryFile 
+                  << " does not match the walk file " << inputFile << "\n";
+        return false;
+    }
+    std::vector<std::string_view> terms;
+    terms.reserve(reader.fileHeader().numTerms);
+    const char* p = dictionary.data();
+    const char* end = p + dictionary.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        terms.emplace_back(p, eol - p);
+        p = eol + 1;
+    }
+
+    std::ofstream file;
+    if (outputFile != "-") {
+        file.open(outputFile, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << outputFile << "\n";
+            return false;
+        }
+    }
+    std::ostream& out = outputFile == "-" ? std::cout : file;
+
+    Walk walk;
+    std::string line;
+    size_t numWalks = 0;
+    while (reader.next(walk)) {
+        line.clear();
+        for (size_t i = 0; i < walk.size(); i++) {
+            if (walk[i] >= terms.size()) {
+                std::clog << "[" << getCurrentTimestamp() << "] Walk " << numWalks << " has unknown ID " << walk[i] << "\n";
+                return false;
+            }
+            line.append(terms[walk[i]]);
+            line.push_back(i + 1 < walk.size() ? ',' : '\n');
+        }
+        out.write(line.data(), line.size());
+        numWalks++;
+    }
+    if (reader.damaged()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Walk file " << inputFile << " is truncated or corrupt after " 
+                  << numWalks << " walks\n";
+        return false;
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Decoded " << numWalks << " walks from " << inputFile << "\n";
+    return static_cast<bool>(out);
+}
+
+// Byte-level BPE model saved by CEGATokenize.save() (src/tokenizer/tokenizer.py):
+// a "cegaBBPE" version line, the split pattern, the number of special tokens,
+// one "<token> <id>" line per special token, then one "<left> <right>" line
+// per merge. Merge i creates token 256 + i, and merges apply in that order.
+class BpeTokenizer {
+private:
+    std::unordered_map<uint64_t, uint32_t> merges;  // (left << 32 | right) -> merged token
+    std::vector<std::pair<std::string, uint32_t>> specialTokens;
+    uint32_t numTokens = 256;
+
+public:
+    static constexpr uint32_t kNoToken = std::numeric_limits<uint32_t>::max();
+
+    bool load(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error opening tokenizer model: " << filename << "\n";
+            return false;
+        }
+        std::string line, pattern;
+        int numSpecial = -1;
+        if (!std::getline(file, line) || line.compare(0, 8, "cegaBBPE") != 0 || !std::getline(file, pattern) || 
+            !std::getline(file, line) || (numSpecial = std::atoi(line.c_str())) < 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] " << filename << " is not a cegaBBPE model\n";
+            return false;
+        }
+        for (int i = 0; i < numSpecial && std::getline(file, line); i++) {
+            std::istringstream iss(line);
+            std::string token;
+            uint32_t id;
+            if (!(iss >> token >> id)) {
+                std::clog << "[" << getCurrentTimestamp() << "] Invalid special token in " << filename << ": " << line << "\n";
+                return false;
+            }
+            specialTokens.emplace_back(token, id);
+        }
+        while (std::getline(file, line)) {
+            std::istringstream iss(line);
+            uint64_t left, right;
+            if (!(iss >> left >> right) || left >= numTokens || right >= numTokens) {
+                std::clog << "[" << getCurrentTimestamp() << "] Invalid merge in " << filename << ": " << line << "\n";
+                return false;
+            }
+            merges[(left << 32) | right] = numTokens++;
+        }
+        std::clog << "[" << getCurrentTimestamp() << "] Loaded tokenizer " << filename << " (" << merges.size() 
+                  << " merges, " << specialTokens.size() << " special tokens)\n";
+        return true;
+    }
+
+    // One past the largest token ID, special tokens included
+    uint32_t vocabSize() const {
+        uint32_t size = numTokens;
+        for (const auto& special : specialTokens)
+            size = std::max(size, special.second + 1);
+        return size;
+    }
+
+    uint32_t specialToken(const std::string& name) const {
+        for (const auto& special : specialTokens) {
+            if (special.first == name)
+                return special.second;
+        }
+        return kNoToken;
+    }
+
+    // Same result as CEGATokenize.encode_no_special(): repeatedly merge every
+    // occurrence of the adjacent pair with the earliest merge
+    void encode(std::string_view text, std::vector<uint32_t>& tokens) const {
+        tokens.assign(reinterpret_cast<const unsigned char*>(text.data()), 
+                      reinterpret_cast<const unsigned char*>(text.data()) + text.size());
+        while (tokens.size() >= 2) {
+            uint64_t bestPair = 0;
+            uint32_t best = kNoToken;
+            for (size_t i = 0; i + 1 < tokens.size(); i++) {
+                uint64_t pair = (static_cast<uint64_t>(tokens[i]) << 32) | tokens[i + 1];
+                auto it = merges.find(pair);
+                if (it != merges.end() && it->second < best) {
+                    best = it->second;
+                    bestPair = pair;
+                }
+            }
+            if (best == kNoToken)
+                break;
+            size_t n = 0;
+            for (size_t i = 0; i < tokens.size(); i++) {
+                if (i + 1 < tokens.size() && ((static_cast<uint64_t>(tokens[i]) << 32) | tokens[i + 1]) == bestPair) {
+                    tokens[n++] = best;
+                    i++;
+                } else {
+                    tokens[n++] = tokens[i];
+                }
+            }
+            tokens.resize(n);
+        }
+    }
+};
+
+// Token files hold the walks as one flat array of token IDs, tokenBytes (2 or
+// 4) bytes each, right after this header: every walk is its terms' tokens
+// separated by the tokens of a space and followed by endOfWalk
+// (<|endofrandomwalk|> when the model has it, otherwise the tokens of "\n").
+// The array can be mapped directly, e.g. numpy.memmap(FILE, dtype=numpy.uint16,
+// offset=32).
+const char kTokenFileMagic[8] = {'R', 'W', 'T', 'O', 'K', 'E', 'N', '\0'};
+const uint32_t kTokenFileVersion = 1;
+
+struct TokenFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t tokenBytes;
+    uint32_t endOfWalk;    // BpeTokenizer::kNoToken without the special token
+    uint64_t vocabSize;
+};
+
+// The tokens of every dictionary term, encoded once and already packed at
+// the output width, so tokenizing a walk is a few memcpy calls
+struct WalkTokens {
+    std::vector<uint64_t> offsets;   // term i is bytes [offsets[i], offsets[i + 1])
+    std::vector<char> bytes;
+    std::string separator;
+    std::string endOfWalk;
+    TokenFileHeader header;
+};
+
+void buildWalkTokens(const Graph& graph, const BpeTokenizer& tokenizer, int numThreads, WalkTokens& walkTokens) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    uint32_t tokenBytes = tokenizer.vocabSize() <= 65536 ? 2 : 4;
+    auto pack = [tokenBytes](const std::vector<uint32_t>& tokens, auto& out) {
+        for (uint32_t token : tokens) {
+            if (tokenBytes == 2) {
+                uint16_t narrow = static_cast<uint16_t>(token);
+                out.insert(out.end(), reinterpret_cast<const char*>(&narrow), reinterpret_cast<const char*>(&narrow) + 2);
+            } else {
+                out.insert(out.end(), reinterpret_cast<const char*>(&token), reinterpret_cast<const char*>(&token) + 4);
+            }
+        }
+    };
+    
+    // Every thread encodes a contiguous ID range; the ranges are then concatenated
+    size_t numTerms = graph.dict.size();
+    std::vector<std::vector<char>> partBytes(numThreads);
+    std::vector<std::vector<uint64_t>> partLengths(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<uint32_t> tokens;
+            std::string term;
+            for (size_t id = numTerms * t / numThreads; id < numTerms * (t + 1) / numThreads; id++) {
+                size_t before = partBytes[t].size();
+                term.clear();
+                graph.dict.outputName(static_cast<NodeId>(id)).appendTo(term);
+                tokenizer.encode(term, tokens);
+                pack(tokens, partBytes[t]);
+                partLengths[t].push_back(partBytes[t].size() - before);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    
+    walkTokens.offsets.assign(1, 0);
+    walkTokens.offsets.reserve(numTerms + 1);
+    walkTokens.bytes.clear();
+    for (int t = 0; t < numThreads; t++) {
+        for (uint64_t length : partLengths[t])
+            walkTokens.offsets.push_back(walkTokens.offsets.back() + length);
+        walkTokens.bytes.insert(walkTokens.bytes.end(), partBytes[t].begin(), partBytes[t].end());
+        std::vector<char>().swap(partBytes[t]);
+    }
+    
+    std::vector<uint32_t> tokens;
+    tokenizer.encode(" ", tokens);
+    walkTokens.separator.clear();
+    pack(tokens, walkTokens.separator);
+    uint32_t endOfWalk = tokenizer.specialToken("<|endofrandomwalk|>");
+    if (endOfWalk != BpeTokenizer::kNoToken)
+        tokens.assign(1, endOfWalk);
+    else
+        tokenizer.encode("\n", tokens);
+    walkTokens.endOfWalk.clear();
+    pack(tokens, walkTokens.endOfWalk);
+    
+    TokenFileHeader& header = walkTokens.header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTokenFileMagic, sizeof(header.magic));
+    header.version = kTokenFileVersion;
+    header.byteOrder = kSnapshotByteOrder;
+    header.tokenBytes = tokenBytes;
+    header.endOfWalk = endOfWalk;
+    header.vocabSize = tokenizer.vocabSize();
+    
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    std::clog << "[" << getCurrentTimestamp() << "] Tokenized " << numTerms << " terms into " 
+              << walkTokens.bytes.size() / tokenBytes << " " << 8 * tokenBytes << "-bit tokens (" 
+              << formatBytes(walkTokens.bytes.size() + walkTokens.offsets.size() * sizeof(uint64_t)) << ") in " 
+              << formatDuration(elapsed) << "\n";
+}
+
+// Append a walk as the packed tokens of its terms
+void emitWalkTokens(WalkEmitter& out, const WalkTokens& walkTokens, const NodeId* walk, size_t walkSize) {
+    size_t length = walkTokens.endOfWalk.size() + (walkSize - 1) * walkTokens.separator.size();
+    for (size_t i = 0; i < walkSize; i++)
+        length += walkTokens.offsets[walk[i] + 1] - walkTokens.offsets[walk[i]];
+
+    char* p = out.reserve(length);
+    for (size_t i = 0; i < walkSize; i++) {
+        if (i > 0) {
+            memcpy(p, walkTokens.separator.data(), walkTokens.separator.size());
+            p += walkTokens.separator.size();
+        }
+        size_t begin = walkTokens.offsets[walk[i]];
+        size_t size = walkTokens.offsets[walk[i] + 1] - begin;
+        memcpy(p, walkTokens.bytes.data() + begin, size);
+        p += size;
+    }
+    memcpy(p, walkTokens.endOfWalk.data(), walkTokens.endOfWalk.size());
+    out.commit(length);
+}
+
+// Contiguous slice [begin, end) of the start-node array
+struct WalkTask {
+    size_t begin;
+    size_t end;
+};
+
+// Splits an index range into small tasks spread over one deque per worker.
+// A worker pops from the back of its own deque and, once that is empty,
+// steals from the front of the others, so threads that draw hub-heavy slices
+// do not hold up the run. With a limit, only tasks starting before limit()
+// are handed out and workers wait for it to move on; every deque stays an
+// ascending run of tasks, so the lowest unfinished task is always running or
+// at the front of some deque, and waiting never deadlocks.
+class WorkStealingScheduler {
+private:
+    struct WorkerQueue {
+        std::mutex mtx;
+        std::deque<WalkTask> tasks;
+    };
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::function<size_t()> limit;
+
+public:
+    WorkStealingScheduler(size_t numItems, size_t grainSize, int numWorkers, 
+                          std::function<size_t()> limit = nullptr) : limit(std::move(limit)) {
+        for (int i = 0; i < numWorkers; i++)
+            queues.push_back(std::make_unique<WorkerQueue>());
+
+        // Each worker starts with a contiguous block of tasks
+        size_t numTasks = (numItems + grainSize - 1) / grainSize;
+        for (size_t t = 0; t < numTasks; t++) {
+            size_t owner = t * numWorkers / std::max<size_t>(1, numTasks);
+            queues[owner]->tasks.push_back({t * grainSize, std::min(numItems, (t + 1) * grainSize)});
+        }
+    }
+
+    // Returns false once no worker has any task left
+    bool next(int worker, WalkTask& task, bool& stolen) {
+        int idleRounds = 0;
+        for (;;) {
+            size_t bound = limit ? limit() : SIZE_MAX;
+            bool remaining = false;
+            {
+                auto& own = *queues[worker];
+                std::lock_guard<std::mutex> lock(own.mtx);
+                if (!own.tasks.empty()) {
+                    remaining = true;
+                    bool back = own.tasks.back().begin < bound;
+                    if (back || own.tasks.front().begin < bound) {
+                        task = back ? own.tasks.back() : own.tasks.front();
+                        back ? own.tasks.pop_back() : own.tasks.pop_front();
+                        stolen = false;
+                        return true;
+                    }
+                }
+            }
+            for (size_t i = 1; i < queues.size(); i++) {
+                auto& victim = *queues[(worker + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mtx);
+                if (!victim.tasks.empty()) {
+                    remaining = true;
+                    if (victim.tasks.front().begin < bound) {
+                        task = victim.tasks.front();
+                        victim.tasks.pop_front();
+                        stolen = true;
+                        return true;
+                    }
+                }
+            }
+            if (!remaining)
+                return false;
+            backoff(idleRounds);
+        }
+    }
+};
+
+struct WorkerStats {
+    double busySeconds = 0;
+    size_t tasks = 0;
+    size_t stolenTasks = 0;
+    size_t walks = 0;
+};
+
+// With minWalkLength > 0, every walk's length is drawn uniformly from
+// [minWalkLength, walkLength] with the walk's own generator. First-order walks
+// of a task are generated kWalkBatchSize at a time by randomWalkBatch and
+// emitted in order; node2vec walks one at a time.
+void generateRandomWalks(const Graph& graph, const std::vector<NodeId>& startNodes, 
+                         WorkStealingScheduler& scheduler, int numWalksPerNode, int walkLength, int minWalkLength,
+                         const WalkBias& bias, uint64_t seed, WalkFormat format, const WalkTokens* walkTokens,
+                         WalkWriter& writer, int threadId, std::mutex& logMutex, std::atomic<size_t>& walkCounter, 
+                         WorkerStats& stats) {
+    
+    WalkEmitter out(writer);
+    size_t batchSize = bias.secondOrder() ? 1 : kWalkBatchSize;
+    size_t stride = walkBufferSize(walkLength);
+    std::vector<NodeId> walks(batchSize * stride);
+    std::vector<WalkRng> rngs;
+    rngs.reserve(batchSize);
+    NodeId starts[kWalkBatchSize];
+    int lengths[kWalkBatchSize];
+    uint32_t sizes[kWalkBatchSize];
+    ThreadMetrics& metrics = threadMetrics();
+    size_t sampleCountdown = 1;
+    
+    WalkTask task;
+    bool stolen;
+    while (scheduler.next(threadId, task, stolen)) {
+        auto taskStart = std::chrono::high_resolution_clock::now();
+        size_t taskWalks = (task.end - task.begin) * numWalksPerNode;
+        size_t taskSteps = 0;
+        out.beginTask(task.begin, task.end);
+        // Walk w of the task is walk w % numWalksPerNode of start node w / numWalksPerNode
+        for (size_t first = 0; first < taskWalks; first += batchSize) {
+            size_t count = std::min(batchSize, taskWalks - first);
+            rngs.clear();
+            for (size_t b = 0; b < count; b++) {
+                size_t w = first + b;
+                starts[b] = startNodes[task.begin + w / numWalksPerNode];
+                // Walk i of a node always draws from the same stream
+                rngs.emplace_back(seed, starts[b], static_cast<uint32_t>(w % numWalksPerNode));
+                lengths[b] = walkLength;
+                if (minWalkLength > 0 && minWalkLength < walkLength)
+                    lengths[b] = minWalkLength + static_cast<int>(boundedRandom(rngs[b], walkLength - minWalkLength + 1));
+            }
+            
+            bool timed = gMetricsEnabled && sampleCountdown <= count;
+            sampleCountdown = timed ? kMetricsSampleEvery : sampleCountdown - (gMetricsEnabled ? count : 0);
+            uint64_t walkStart = timed ? metricsClock() : 0;
+            if (batchSize > 1)
+                randomWalkBatch(graph, count, starts, lengths, rngs.data(), walks.data(), stride, sizes);
+            else
+                sizes[0] = static_cast<uint32_t>(randomWalk(graph, starts[0], lengths[0], bias, rngs[0], walks.data()));
+            uint64_t serializeStart = timed ? metricsClock() : 0;
+            
+            size_t steps = 0;
+            for (size_t b = 0; b < count; b++) {
+                const NodeId* walk = walks.data() + b * stride;
+                if (format == kFormatTokens)
+                    emitWalkTokens(out, *walkTokens, walk, sizes[b]);
+                else
+                    emitWalk(out, format, graph, walk, sizes[b], lengths[b]);
+                steps += sizes[b] / 2;
+            }
+            if (timed) {
+                metrics.record(kPhaseStep, (serializeStart - walkStart) / std::max<size_t>(1, steps));
+                metrics.record(kPhaseSerialize, (metricsClock() - serializeStart) / count);
+            }
+            taskSteps += steps;
+        }
+        out.endTask();
+        std::chrono::duration<double> taskTime = std::chrono::high_resolution_clock::now() - taskStart;
+        stats.busySeconds += taskTime.count();
+        stats.tasks++;
+        stats.stolenTasks += stolen;
+        stats.walks += taskWalks;
+        if (gMetricsEnabled) {
+            metrics.add(kCounterWalks, taskWalks);
+            metrics.add(kCounterSteps, taskSteps);
+        }
+        
+        // Periodic status update; the shared counter is touched once per task
+        size_t before = walkCounter.fetch_add(taskWalks, std::memory_order_relaxed);
+        if (before / 10000 != (before + taskWalks) / 10000) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::clog << "[" << getCurrentTimestamp() << "] Generated " << before + taskWalks << " walks\n";
+        }
+    }
+    
+    // Make sure to flush remaining walks
+    out.flush();
+}
+
+// How start nodes are chosen. Candidates are the nodes with out-edges, or
+// the nodes named in seedFile. Without stratification a fraction sampleRate
+// of them is drawn; with it, up to perStratum nodes are drawn from every
+// degree bucket (floor(log2(degree))) and/or rdf:type class.
+struct StartNodeOptions {
+    float sampleRate = 1.0;
+    bool byDegree = false;
+    bool byType = false;
+    size_t perStratum = 1000;
+    std::string seedFile;
+    uint64_t seed = 0;              // for the reservoirs
+
+    bool stratified() const { return byDegree || byType; }
+};
+
+// Fixed-size uniform sample of a stream (Vitter's algorithm R)
+struct Reservoir {
+    size_t capacity = 0;
+    size_t seen = 0;
+    std::vector<NodeId> items;
+
+    void offer(NodeId node, std::mt19937_64& rng) {
+        seen++;
+        if (items.size() < capacity) {
+            items.push_back(node);
+        } else {
+            uint64_t slot = rng() % seen;
+            if (slot < capacity)
+                items[slot] = node;
+        }
+    }
+};
+
+// Resolve the first comma-separated field of every line of filename (e.g.
+// the rdf_uri column of alignments.csv); bare IRIs are looked up with and
+// without angle brackets. Lines that name no node, like a header, are skipped.
+bool loadSeedNodes(const Graph& graph, const std::string& filename, std::vector<NodeId>& nodes) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening seed node file: " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    size_t unknown = 0, leaves = 0;
+    while (std::getline(file, line)) {
+        std::string term = line.substr(0, line.find(','));
+        while (!term.empty() && isBlank(term.back()))
+            term.pop_back();
+        if (term.empty())
+            continue;
+        NodeId node = graph.dict.find(term);
+        if (node == kInvalidNode && term.front() != '<')
+            node = graph.dict.find("<" + term + ">");
+        if (node == kInvalidNode) {
+            unknown++;
+        } else if (graph.degree(node) == 0) {
+            leaves++;
+        } else {
+            nodes.push_back(node);
+        }
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Loaded " << nodes.size() << " seed nodes from " << filename 
+              << " (" << unknown << " not in the graph, " << leaves << " without out-edges)\n";
+    return true;
+}
+
+// Draw start nodes in one pass over the candidates with a reservoir per
+// stratum, so the candidate list is never copied or shuffled
+std::vector<NodeId> getStartNodes(const Graph& graph, const StartNodeOptions& options = StartNodeOptions()) {
+    std::vector<NodeId> seeds;
+    if (!options.seedFile.empty() && !loadSeedNodes(graph, options.seedFile, seeds))
+        return seeds;
+    bool useSeeds = !options.seedFile.empty();
+    auto forEachCandidate = [&](auto&& visit) {
+        if (useSeeds) {
+            for (NodeId node : seeds)
+                visit(node);
+        } else {
+            for (NodeId node = 0; node < graph.numNodes(); node++) {
+                if (graph.degree(node) > 0)
+                    visit(node);
+            }
+        }
+    };
+    if (!options.stratified() && options.sampleRate >= 1.0) {
+        if (useSeeds)
+            return seeds;
+        std::vector<NodeId> nodes;
+        forEachCandidate([&](NodeId node) { nodes.push_back(node); });
+        return nodes;
+    }
+
+    std::mt19937_64 rng(options.seed);
+    std::vector<NodeId> nodes;
+    if (!options.stratified()) {
+        size_t numCandidates = 0;
+        forEachCandidate([&](NodeId) { numCandidates++; });
+        Reservoir sample;
+        sample.capacity = static_cast<size_t>(numCandidates * std::max(0.0f, options.sampleRate));
+        sample.items.reserve(sample.capacity);
+        forEachCandidate([&](NodeId node) { sample.offer(node, rng); });
+        return std::move(sample.items);
+    }
+
+    // Stratum key: the node's first rdf:type object (kInvalidNode if untyped)
+    // in the high half, its degree bucket in the low half
+    NodeId typePredicate = graph.dict.find("<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>");
+    std::map<uint64_t, Reservoir> strata;
+    forEachCandidate([&](NodeId node) {
+        uint64_t type = kInvalidNode, bucket = 0;
+        if (options.byType && typePredicate != kInvalidNode) {
+            const Edge* edges = graph.edgesOf(node);
+            for (size_t j = 0; j < graph.degree(node); j++) {
+                if (edges[j].predicate == typePredicate) {
+                    type = edges[j].target;
+                    break;
+                }
+            }
+        }
+        if (options.byDegree) {
+            for (size_t degree = graph.degree(node); degree > 1; degree >>= 1)
+                bucket++;
+        }
+        Reservoir& reservoir = strata[(type << 32) | bucket];
+        reservoir.capacity = options.perStratum;
+        reservoir.offer(node, rng);
+    });
+    for (const auto& stratum : strata)
+        nodes.insert(nodes.end(), stratum.second.items.begin(), stratum.second.items.end());
+    std::clog << "[" << getCurrentTimestamp() << "] Sampled up to " << options.perStratum << " start nodes from each of "
+              << strata.size() << " strata (" << (options.byDegree ? "degree" : "") 
+              << (options.byDegree && options.byType ? " and " : "") << (options.byType ? "rdf:type" : "") << ")\n";
+    return nodes;
+}
+
+// Synthetic graph with a power-law out-degree: node i gets about
+// maxDegree / (i + 1) edges, and targets are drawn with a bias towards the
+// low-numbered hubs so walks keep revisiting high-degree nodes.
+Graph buildSkewedGraph(size_t numNodes, size_t maxDegree, size_t numPredicates, unsigned seed) {
+    Graph graph;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (size_t i = 0; i < numNodes; i++)
+        graph.dict.intern("<http://example.org/resource/n" + std::to_string(i) + ">");
+    std::vector<NodeId> predicates;
+    for (size_t i = 0; i < numPredicates; i++)
+        predicates.push_back(graph.dict.intern("<http://example.org/property/p" + std::to_string(i) + ">"));
+
+    std::vector<std::vector<Triple>> parts(1);
+    for (size_t i = 0; i < numNodes; i++) {
+        size_t degree = std::max<size_t>(1, maxDegree / (i + 1));
+        for (size_t j = 0; j < degree; j++) {
+            double u = unit(rng);
+            NodeId target = static_cast<NodeId>(std::min(numNodes - 1, static_cast<size_t>(numNodes * u * u * u)));
+            parts[0].push_back({static_cast<NodeId>(i), predicates[rng() % numPredicates], target});
+        }
+    }
+    buildAdjacency(graph, parts);
+    return graph;
+}
+
+// Graph far larger than the cache for the batched kernel: every node has
+// `degree` out-edges to uniformly random targets, so almost every hop misses.
+// Only the adjacency is built; the kernels never look at the dictionary.
+Graph buildUniformGraph(size_t numNodes, size_t degree, unsigned seed) {
+    Graph graph;
+    std::mt19937 rng(seed);
+    std::vector<uint64_t> offsets(numNodes + 1);
+    std::vector<Edge> edges(numNodes * degree);
+    for (size_t i = 0; i <= numNodes; i++)
+        offsets[i] = i * degree;
+    for (auto& edge : edges)
+        edge = {static_cast<NodeId>(rng() % 64), static_cast<NodeId>(rng() % numNodes)};
+    graph.offsets.assign(std::move(offsets));
+    graph.edges.assign(std::move(edges));
+    return graph;
+}
+
+// The scalar kernel against randomWalkBatch on the same walk streams; both
+// must produce the same walks
+void benchmarkBatchedKernel(const Graph& graph, const std::vector<NodeId>& startNodes, int numWalks, int walkLength) {
+    size_t stride = walkBufferSize(walkLength);
+    std::vector<NodeId> buffer(kWalkBatchSize * stride);
+    double rates[2];
+    uint64_t checksums[2] = {0, 0};
+    for (int batched = 1; batched >= 0; batched--) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<WalkRng> rngs;
+        NodeId starts[kWalkBatchSize];
+        int lengths[kWalkBatchSize];
+        uint32_t sizes[kWalkBatchSize];
+        for (int first = 0; first < numWalks; first += kWalkBatchSize) {
+            size_t count = std::min<size_t>(kWalkBatchSize, numWalks - first);
+            rngs.clear();
+            for (size_t b = 0; b < count; b++) {
+                starts[b] = startNodes[(first + b) % startNodes.size()];
+                lengths[b] = walkLength;
+                rngs.emplace_back(12345, starts[b], static_cast<uint32_t>(first + b));
+            }
+            if (batched) {
+                randomWalkBatch(graph, count, starts, lengths, rngs.data(), buffer.data(), stride, sizes);
+            } else {
+                for (size_t b = 0; b < count; b++)
+                    sizes[b] = static_cast<uint32_t>(randomWalk(graph, starts[b], walkLength, rngs[b], buffer.data() + b * stride));
+            }
+            for (size_t b = 0; b < count; b++)
+                checksums[batched] += hashBytes(reinterpret_cast<const char*>(buffer.data() + b * stride), sizes[b] * sizeof(NodeId));
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        rates[batched] = numWalks / elapsed.count();
+        std::clog << "[" << getCurrentTimestamp() << "] " << (batched ? "batched kernel (64 walks in lockstep)" 
+                                                                       : "scalar kernel, counter-based RNG") 
+                  << ": " << numWalks << " walks in " << formatDuration(elapsed) << " (" 
+                  << static_cast<int>(rates[batched]) << " walks/sec)\n";
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Batched speedup " << std::fixed << std::setprecision(2) 
+              << rates[1] / rates[0] << "x" << std::defaultfloat 
+              << (checksums[0] == checksums[1] ? "; walks identical\n" : "; WALKS DIFFER\n");
+}
+
+// Compare the shuffling kernel with the O(1) sampling kernel on a skewed
+// graph, then the scalar and batched kernels on one far larger than the cache
+void benchmarkWalkKernels(int numWalks, int walkLength) {
+    Graph graph = buildSkewedGraph(200000, 200000, 500, 42);
+    std::clog << "[" << getCurrentTimestamp() << "] Kernel benchmark graph: " << graph.numNodes() << " nodes, " 
+              << graph.numEdges() << " edges, max out-degree " << graph.degree(0) << "\n";
+
+    std::vector<NodeId> startNodes = getStartNodes(graph);
+    std::mt19937 rng(12345);
+    std::vector<NodeId> buffer(walkBufferSize(walkLength));
+    size_t checksum = 0;
+
+    auto run = [&](const char* label, int walks, auto&& walkOnce) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < walks; i++)
+            checksum += walkOnce(startNodes[i % startNodes.size()]);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        std::clog << "[" << getCurrentTimestamp() << "] " << label << ": " << walks << " walks in " 
+                  << formatDuration(elapsed) << " (" << static_cast<int>(walks / elapsed.count()) << " walks/sec)\n";
+    };
+    // The shuffle kernel is O(degree) per hop, so it gets a smaller sample
+    run("shuffle kernel", std::max(1000, numWalks / 100), 
+        [&](NodeId start) { return shuffleRandomWalk(graph, start, walkLength, rng).size(); });
+    run("O(1) kernel", numWalks, 
+        [&](NodeId start) { return randomWalk(graph, start, walkLength, rng, buffer.data()); });
+    uint32_t walkIndex = 0;
+    run("O(1) kernel, counter-based RNG", numWalks, [&](NodeId start) {
+        WalkRng walkRng(12345, start, walkIndex++);
+        return randomWalk(graph, start, walkLength, walkRng, buffer.data());
+    });
+    WalkBias bias = makeWalkBias(0.5, 2.0);
+    run("node2vec kernel (p=0.5, q=2)", numWalks, 
+        [&](NodeId start) { return node2vecWalk(graph, start, walkLength, bias, rng, buffer.data()); });
+    std::clog << "[" << getCurrentTimestamp() << "] (checksum " << checksum << ")\n";
+    benchmarkBatchedKernel(graph, startNodes, numWalks, walkLength);
+    
+    // 8M nodes with 8 edges each: 512 MB of edges and 64 MB of offsets
+    const size_t largeNodes = 1 << 23;
+    Graph large = buildUniformGraph(largeNodes, 8, 42);
+    std::clog << "[" << getCurrentTimestamp() << "] Large benchmark graph: " << large.numNodes() << " nodes, " 
+              << large.numEdges() << " edges (" << formatBytes(large.memoryUsage()) << ")\n";
+    std::vector<NodeId> largeStarts(1 << 20);
+    std::mt19937 startRng(7);
+    for (auto& node : largeStarts)
+        node = static_cast<NodeId>(startRng() % largeNodes);
+    benchmarkBatchedKernel(large, largeStarts, numWalks, walkLength);
+}
+
+void runParallelRandomWalks(const Graph& graph, const std::string& outputFile, 
+                           int numWalksPerNode, int walkLength, int minWalkLength, 
+                           const StartNodeOptions& startOptions, int numThreads,
+                           const WalkBias& bias, uint64_t seed, bool deterministic, WalkFormat format = kFormatCsv,
+                           const WalkTokens* walkTokens = nullptr) {
+    
+    std::clog << "[" << getCurrentTimestamp() << "] Starting parallel random walks generation\n";
+    auto startTime = std::chrono::high_resolution_clock::now();
+    
+    // Get nodes to start walks from
+    std::vector<NodeId> startNodes = getStartNodes(graph, startOptions);
+    if (startNodes.empty()) {
+        std::clog << "[" << getCurrentTimestamp() << "] No start nodes selected\n";
+        return;
+    }
+    
+    std::clog << "[" << getCurrentTimestamp() << "] Selected " << startNodes.size() 
+              << " start nodes (sampling rate: " << startOptions.sampleRate << ")\n";
+    if (bias.secondOrder()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Using node2vec walks with p=" << bias.p 
+                  << ", q=" << bias.q << "\n";
+    }
+    
+    // Binary output refers to a sidecar dictionary next to the walk file
+    uint64_t dictionaryChecksum = 0;
+    if (format == kFormatBinary && !writeDictionaryFile(graph, outputFile + ".dict", dictionaryChecksum)) {
+        return;
+    }
+    
+    // Open output file
+    int outFd = ::open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << outputFile << "\n";
+        return;
+    }
+    if (format == kFormatBinary || format == kFormatTokens) {
+        WalkFileHeader header = makeWalkFileHeader(graph.dict.size(), dictionaryChecksum);
+        const void* data = &header;
+        size_t size = sizeof(header);
+        if (format == kFormatTokens) {
+            data = &walkTokens->header;
+            size = sizeof(walkTokens->header);
+        }
+        if (::write(outFd, data, size) != static_cast<ssize_t>(size)) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error writing output file: " << outputFile << "\n";
+            ::close(outFd);
+            return;
+        }
+    }
+    
+    // Prepare for parallel execution: three 1 MB output chunks per worker.
+    // With a fixed seed the writer keeps start-node order, so the file does
+    // not depend on the thread count.
+    std::vector<std::thread> threads;
+    std::mutex logMutex;
+    std::atomic<size_t> totalWalks{0};
+    WalkWriter writer(outFd, 3 * numThreads + 2, 1 << 20, deterministic);
+    
+    // Split the start nodes into small tasks (about 32 per thread) that idle
+    // workers can steal
+    size_t grainSize = std::max<size_t>(1, std::min<size_t>(256, startNodes.size() / (numThreads * 32)));
+    WorkStealingScheduler scheduler(startNodes.size(), grainSize, numThreads, 
+                                    orderedTaskLimit(writer, grainSize, numThreads));
+    std::vector<WorkerStats> workerStats(numThreads);
+    auto walkStart = std::chrono::high_resolution_clock::now();
+    
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back(generateRandomWalks, std::ref(graph), std::cref(startNodes), std::ref(scheduler),
+                            numWalksPerNode, walkLength, minWalkLength, std::cref(bias), seed, format, walkTokens, 
+                            std::ref(writer),
+                            i, std::ref(logMutex), std::ref(totalWalks), std::ref(workerStats[i]));
+    }
+    
+    // Wait for all threads to complete
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    writer.finish();
+    ::close(outFd);
+    if (!writer.ok()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Output file " << outputFile << " is incomplete\n";
+    }
+    
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> totalTime = endTime - startTime;
+    std::chrono::duration<double> walkTime = endTime - walkStart;
+    
+    for (int i = 0; i < numThreads; i++) {
+        const auto& stats = workerStats[i];
+        double utilization = walkTime.count() > 0 ? 100.0 * stats.busySeconds / walkTime.count() : 0;
+        std::clog << "[" << getCurrentTimestamp() << "] Thread " << i << ": " << stats.walks << " walks, " 
+                  << stats.tasks << " tasks (" << stats.stolenTasks << " stolen), " 
+                  << std::fixed << std::setprecision(1) << utilization << "% busy\n" << std::defaultfloat;
+    }
+    
+    std::clog << "[" << getCurrentTimestamp() << "] Random walks generation complete: Generated " 
+              << totalWalks << " walks in " << formatDuration(totalTime) << " (" 
+              << formatBytes(writer.bytes()) << " written)\n";
+    
+    double rate = totalWalks / totalTime.count();
+    std::clog << "[" << getCurrentTimestamp() << "] Performance: " << static_cast<int>(rate) 
+              << " walks/sec\n";
+}
+
+// Aligned walks: an alignment file pairs RDF entities with property graph
+// nodes (rdf_uri,pg_id, like data/alignments.csv). Both graphs stay loaded
+// and every pair gets numWalks walks from each side in lockstep, written as
+// one line per walk index: the RDF walk, a tab, then the PG walk. Walk k of
+// the RDF side draws from the same stream as walk k of that node in a plain
+// run; the PG side uses streams above 2^32, so the two never share one.
+struct AlignedPair {
+    NodeId rdf;
+    NodeId pg;
+};
+
+const uint64_t kPgStreamBase = 1ULL << 32;
+
+// Resolve the pairs of an alignment file. RDF IRIs may be bare, PG ids are
+// the id column of nodes.csv. Pairs with a side missing from its graph are
+// skipped; a side without out-edges gives one-entity walks.
+bool loadAlignments(const Graph& rdfGraph, const Graph& pgGraph, const std::string& filename, 
+                    std::vector<AlignedPair>& pairs) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening alignment file: " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    std::vector<std::string> fields;
+    if (!std::getline(file, line) || !splitCsvLine(line, fields)) {
+        std::clog << "[" << getCurrentTimestamp() << "] Malformed alignment header in " << filename << "\n";
+        return false;
+    }
+    int rdfColumn = findColumn(fields, {"rdf_uri", "rdf"});
+    int pgColumn = findColumn(fields, {"pg_id", "pg"});
+    if (rdfColumn < 0 || pgColumn < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] " << filename << " needs rdf_uri and pg_id columns\n";
+        return false;
+    }
+    size_t numColumns = fields.size();
+    int lineNum = 1;
+    size_t unknownRdf = 0, unknownPg = 0, leaves = 0;
+    std::string term;
+    while (std::getline(file, line)) {
+        lineNum++;
+        if (line.empty() || line == "\r")
+            continue;
+        if (!splitCsvLine(line, fields) || fields.size() != numColumns) {
+            std::clog << "[" << getCurrentTimestamp() << "] Malformed alignment on line " << lineNum << ": " << line << "\n";
+            return false;
+        }
+        const std::string& uri = fields[rdfColumn];
+        NodeId rdf = rdfGraph.dict.find(uri);
+        if (rdf == kInvalidNode && !uri.empty() && uri.front() != '<')
+            rdf = rdfGraph.dict.find("<" + uri + ">");
+        NodeId pg = pgGraph.dict.find(pgNodeTerm(term, fields[pgColumn]));
+        unknownRdf += rdf == kInvalidNode;
+        unknownPg += pg == kInvalidNode;
+        if (rdf == kInvalidNode || pg == kInvalidNode)
+            continue;
+        leaves += rdfGraph.degree(rdf) == 0 || pgGraph.degree(pg) == 0;
+        pairs.push_back({rdf, pg});
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Loaded " << pairs.size() << " aligned pairs from " << filename 
+              << " (" << unknownRdf << " RDF and " << unknownPg << " PG nodes not in their graph, " 
+              << leaves << " pairs with a side without out-edges)\n";
+    return true;
+}
+
+void generateAlignedWalks(const Graph& rdfGraph, const Graph& pgGraph, const std::vector<AlignedPair>& pairs, 
+                          WorkStealingScheduler& scheduler, int numWalks, int walkLength, const WalkBias& bias, 
+                          uint64_t seed, WalkWriter& writer, int threadId, std::mutex& logMutex, 
+                          std::atomic<size_t>& walkCounter, WorkerStats& stats) {
+    WalkEmitter out(writer);
+    std::vector<NodeId> rdfWalk(walkBufferSize(walkLength));
+    std::vector<NodeId> pgWalk(walkBufferSize(walkLength));
+    
+    WalkTask task;
+    bool stolen;
+    while (scheduler.next(threadId, task, stolen)) {
+        auto taskStart = std::chrono::high_resolution_clock::now();
+        size_t taskWalks = 0;
+        out.beginTask(task.begin, task.end);
+        for (size_t idx = task.begin; idx < task.end; idx++) {
+            const AlignedPair& pair = pairs[idx];
+            for (int i = 0; i < numWalks; i++) {
+                WalkRng rdfRng(seed, pair.rdf, i);
+                WalkRng pgRng(seed, kPgStreamBase + pair.pg, i);
+                size_t rdfSize = randomWalk(rdfGraph, pair.rdf, walkLength, bias, rdfRng, rdfWalk.data());
+                size_t pgSize = randomWalk(pgGraph, pair.pg, walkLength, bias, pgRng, pgWalk.data());
+                size_t rdfLength = walkCSVLength(rdfGraph, rdfWalk.data(), rdfSize);
+                size_t pgLength = walkCSVLength(pgGraph, pgWalk.data(), pgSize);
+                char* p = out.reserve(rdfLength + pgLength);
+                p = copyWalkCSV(p, rdfGraph, rdfWalk.data(), rdfSize, '\t');
+                copyWalkCSV(p, pgGraph, pgWalk.data(), pgSize, '\n');
+                out.commit(rdfLength + pgLength);
+                taskWalks++;
+            }
+        }
+        out.endTask();
+        std::chrono::duration<double> taskTime = std::chrono::high_resolution_clock::now() - taskStart;
+        stats.busySeconds += taskTime.count();
+        stats.tasks++;
+        stats.stolenTasks += stolen;
+        stats.walks += taskWalks;
+        
+        size_t before = walkCounter.fetch_add(taskWalks, std::memory_order_relaxed);
+        if (before / 10000 != (before + taskWalks) / 10000) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::clog << "[" << getCurrentTimestamp() << "] Generated " << before + taskWalks << " walk pairs\n";
+        }
+    }
+    out.flush();
+}
+
+void runAlignedRandomWalks(const Graph& rdfGraph, const Graph& pgGraph, const std::string& alignmentFile, 
+                           const std::string& outputFile, int numWalks, int walkLength, int numThreads, 
+                           const WalkBias& bias, uint64_t seed, bool deterministic) {
+    std::clog << "[" << getCurrentTimestamp() << "] Starting aligned random walks generation\n";
+    auto startTime = std::chrono::high_resolution_clock::now();
+    
+    std::vector<AlignedPair> pairs;
+    if (!loadAlignments(rdfGraph, pgGraph, alignmentFile, pairs))
+        return;
+    if (pairs.empty()) {
+        std::clog << "[" << getCurrentTimestamp() << "] No aligned pair has both sides in the graphs\n";
+        return;
+    }
+    
+    int outFd = ::open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << outputFile << "\n";
+        return;
+    }
+    
+    // Same pipeline as runParallelRandomWalks, with pairs in place of start nodes
+    std::vector<std::thread> threads;
+    std::mutex logMutex;
+    std::atomic<size_t> totalWalks{0};
+    WalkWriter writer(outFd, 3 * numThreads + 2, 1 << 20, deterministic);
+    size_t grainSize = std::max<size_t>(1, std::min<size_t>(256, pairs.size() / (numThreads * 32)));
+    WorkStealingScheduler scheduler(pairs.size(), grainSize, numThreads, 
+                                    orderedTaskLimit(writer, grainSize, numThreads));
+    std::vector<WorkerStats> workerStats(numThreads);
+    
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back(generateAlignedWalks, std::cref(rdfGraph), std::cref(pgGraph), std::cref(pairs), 
+                             std::ref(scheduler), numWalks, walkLength, std::cref(bias), seed, std::ref(writer), 
+                             i, std::ref(logMutex), std::ref(totalWalks), std::ref(workerStats[i]));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    writer.finish();
+    ::close(outFd);
+    if (!writer.ok()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Output file " << outputFile << " is incomplete\n";
+    }
+    
+    std::chrono::duration<double> totalTime = std::chrono::high_resolution_clock::now() - startTime;
+    std::clog << "[" << getCurrentTimestamp() << "] Aligned walks complete: Generated " << totalWalks 
+              << " walk pairs for " << pairs.size() << " alignments in " << formatDuration(totalTime) << " (" 
+              << formatBytes(writer.bytes()) << " written)\n";
+    std::clog << "[" << getCurrentTimestamp() << "] Performance: " 
+              << static_cast<int>(totalWalks / totalTime.count()) << " walk pairs/sec\n";
+}
+
+// Hands out start nodes in batches so that successive requests cover the
+// graph without repeats. Every client name has its own cursor, a position in
+// an endless sequence of epochs; epoch e visits all start nodes once, in the
+// order of a pseudo-random permutation keyed by e. The permutation is computed
+// per index (a Feistel network over the index bits, cycle-walked into range),
+// so nothing is reshuffled at an epoch boundary and a batch costs O(batch).
+// The start nodes can change while the server runs (see update): a node keeps
+// its position for good, new nodes are appended and dropped ones are skipped.
+// An epoch permutes the positions that existed when it began and then visits
+// the ones appended during it in order, so cursors survive every update.
+// Batches of one cursor take no lock: each claims the next batchSize positions
+// of the epoch with a fetch_add, skipping the inactive ones, and the first
+// batch to run past the end of the epoch publishes the next one.
+class NodeManager {
+private:
+    // One published set of start nodes; an older list is a prefix of every newer one
+    struct NodeList {
+        std::vector<NodeId> nodes;
+        std::vector<char> active;   // 0 for nodes that are no longer start nodes
+        size_t numActive = 0;
+    };
+
+    // One pass of a cursor over the start nodes
+    struct Epoch {
+        uint64_t number;
+        size_t size;                // positions permuted in this epoch
+        int halfBits;               // Feistel half width covering size
+        std::atomic<uint64_t> next; // first position not yet handed out
+
+        Epoch(uint64_t number, size_t size, uint64_t claimed) : number(number), size(size), next(claimed) {
+            halfBits = 1;
+            while ((1ULL << (2 * halfBits)) < size)
+                halfBits++;
+        }
+    };
+
+    struct Cursor {
+        std::shared_ptr<Epoch> epoch;   // null before the first batch; std::atomic_load/atomic_compare_exchange
+    };
+
+    std::shared_ptr<const NodeList> current;    // read and replaced with std::atomic_load/atomic_store
+    std::vector<uint32_t> positions;            // NodeId -> position in the list; only used by update
+    uint64_t seed;
+    size_t batchSize;
+    Cursor defaultCursor;
+    std::unordered_map<std::string, std::unique_ptr<Cursor>> clientCursors;
+    std::shared_mutex cursorsMutex; // exclusive only to add a client to clientCursors
+    static constexpr uint32_t kNoPosition = std::numeric_limits<uint32_t>::max();
+
+    // Position of the index-th node in epoch's order over size positions
+    size_t permute(size_t index, uint64_t epoch, size_t size, int halfBits) const {
+        uint64_t mask = (1ULL << halfBits) - 1;
+        uint64_t key = mix64(seed ^ mix64(epoch));
+        uint64_t value = index;
+        do {
+            uint64_t left = value >> halfBits, right = value & mask;
+            for (int round = 0; round < 4; round++) {
+                uint64_t next = left ^ (mix64(right ^ key ^ (static_cast<uint64_t>(round) << 56)) & mask);
+                left = right;
+                right = next;
+            }
+            value = (left << halfBits) | right;
+        } while (value >= size);
+        return value;
+    }
+
+    Cursor& cursorFor(const std::string& client) {
+        if (client.empty())
+            return defaultCursor;
+        {
+            std::shared_lock<std::shared_mutex> lock(cursorsMutex);
+            auto it = clientCursors.find(client);
+            if (it != clientCursors.end())
+                return *it->second;
+        }
+        std::lock_guard<std::shared_mutex> lock(cursorsMutex);
+        auto& cursor = clientCursors[client];
+        if (!cursor)
+            cursor = std::make_unique<Cursor>();
+        return *cursor;
+    }
+
+public:
+    NodeManager(const std::vector<NodeId>& startNodes, uint64_t seed, size_t batchSize = 100) 
+        : current(std::make_shared<NodeList>()), seed(seed), batchSize(batchSize) {
+        update(startNodes);
+        std::clog << "[" << getCurrentTimestamp() << "] NodeManager initialized with " 
+                  << current->nodes.size() << " potential start nodes\n";
+    }
+
+    // Make startNodes the start nodes from now on. Known nodes keep their
+    // position, new ones are appended and the others are skipped until they
+    // come back. Called by one thread at a time, concurrently with batches.
+    void update(const std::vector<NodeId>& startNodes) {
+        auto list = std::make_shared<NodeList>(*std::atomic_load(&current));
+        size_t known = list->nodes.size();
+        std::fill(list->active.begin(), list->active.end(), 0);
+        for (NodeId node : startNodes) {
+            if (node >= positions.size())
+                positions.resize(node + 1, kNoPosition);
+            if (positions[node] == kNoPosition) {
+                positions[node] = static_cast<uint32_t>(list->nodes.size());
+                list->nodes.push_back(node);
+                list->active.push_back(1);
+            } else {
+                list->active[positions[node]] = 1;
+            }
+        }
+        list->numActive = std::count(list->active.begin(), list->active.end(), 1);
+        if (known > 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] Start nodes updated: " << list->numActive << " of " 
+                      << list->nodes.size() << " active, " << list->nodes.size() - known << " new\n";
+        }
+        std::atomic_store(&current, std::shared_ptr<const NodeList>(std::move(list)));
+    }
+    
+    // Next batch for a client (empty name: the shared anonymous cursor). A
+    // batch never spans two epochs, so it holds no repeated node; it is short
+    // when some of its positions are inactive or the epoch ends within it.
+    std::vector<NodeId> getNextBatch(const std::string& client = std::string()) {
+        std::vector<NodeId> batch;
+        std::shared_ptr<const NodeList> list = std::atomic_load(&current);
+        if (list->numActive == 0)
+            return batch;
+        size_t numNodes = list->nodes.size();
+        Cursor& cursor = cursorFor(client);
+        std::shared_ptr<Epoch> epoch = std::atomic_load(&cursor.epoch);
+        batch.reserve(batchSize);
+        while (batch.empty()) {
+            size_t first = epoch ? epoch->next.fetch_add(batchSize, std::memory_order_relaxed) : numNodes;
+            bool newEpoch = false;
+            if (first >= numNodes) {
+                // Past the end: start the next epoch with this batch, unless another one did first
+                auto next = std::make_shared<Epoch>(epoch ? epoch->number + 1 : 0, numNodes, batchSize);
+                if (!std::atomic_compare_exchange_strong(&cursor.epoch, &epoch, next))
+                    continue;
+                epoch = std::move(next);
+                first = 0;
+                newEpoch = epoch->number > 0;
+            }
+            size_t end = std::min(first + batchSize, numNodes);
+            for (size_t position = first; position < end; position++) {
+                size_t index = position < epoch->size ? permute(position, epoch->number, epoch->size, epoch->halfBits)
+                                                      : position;
+                if (list->active[index])
+                    batch.push_back(list->nodes[index]);
+            }
+            
+            if (newEpoch) {
+                std::clog << "[" << getCurrentTimestamp() << "] Starting epoch " << epoch->number 
+                          << (client.empty() ? std::string() : " for client " + client) << "\n";
+            }
+            std::clog << "[" << getCurrentTimestamp() << "] Returning batch of " 
+                      << batch.size() << " nodes (" << end << "/" 
+                      << numNodes << " used in epoch " << epoch->number << ")\n";
+        }
+                  
+        return batch;
+    }
+};
+
+// Fixed pool of worker threads draining a shared task queue
+class WorkerPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+
+public:
+    explicit WorkerPool(int numThreads) {
+        for (int i = 0; i < numThreads; i++) {
+            workers.emplace_back([this]() {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                        if (tasks.empty())
+                            return;
+                        task = std::move(tasks.front());
+                        tasks.pop_front();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+};
+
+// Streamed responses are a sequence of frames: a 4-byte big-endian payload
+// length, a 1-byte frame type and the payload. Walk frames always hold whole
+// walks (CSV lines or binary records); a binary stream starts with a header
+// frame carrying a WalkFileHeader, and every stream ends with a done frame.
+enum FrameType : char {
+    kFrameHeader = 'H',
+    kFrameWalks = 'W',
+    kFrameTerms = 'T',
+    kFrameError = 'E',
+    kFrameDone = 'D',
+    // Between shards
+    kFrameContinuations = 'C',
+    kFrameStarts = 'S',
+    kFrameProgress = 'P',
+    kFrameWalkable = 'N'
+};
+
+const size_t kStreamFrameSize = 256 * 1024;
+
+// A request line is taken as it is once this long passes without more bytes
+// or it grows past kMaxRequestLine
+const std::chrono::milliseconds kRequestLineTimeout(200);
+const size_t kMaxRequestLine = 64 * 1024;
+
+// Largest walks per start node and walk length a request may ask for
+const int kMaxRequestWalks = 1 << 20;
+const int kMaxRequestWalkLength = 1 << 16;
+
+// Settings shared by every request of a server
+struct ServerContext {
+    WalkFormat format;
+    WalkBias bias;                  // default node2vec parameters
+    std::string outputDir;          // absolute path of walks_output
+};
+
+// One published state of the server's graph. A request takes the current
+// version when it is dispatched and holds it until it is done. An update
+// builds the next version on the side and swaps the pointer, so requests
+// never wait for an update and never see half of one. An old version is freed
+// when its last request lets go of it (RCU, with the reference count standing
+// in for the grace period).
+struct GraphVersion {
+    uint64_t number = 0;
+    Graph graph;
+    uint64_t dictionaryChecksum = 0;    // checksum of the binary walk dictionary, 0 if there is none
+};
+
+// Applies ADD_TRIPLES / REMOVE_TRIPLES batches in the background. Deltas
+// queue up while a merge runs and go into the following version together,
+// so a burst of updates costs one merge. published is called with each new
+// version right after it is swapped in.
+class GraphUpdater {
+public:
+    using MergeFunction = std::function<std::shared_ptr<GraphVersion>(const GraphVersion&, 
+                                                                      const std::vector<GraphDelta>&)>;
+    using PublishFunction = std::function<void(const GraphVersion&)>;
+
+private:
+    std::shared_ptr<const GraphVersion> current;    // read and replaced with std::atomic_load/atomic_store
+    MergeFunction merge;
+    PublishFunction published;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<GraphDelta> pending;
+    uint64_t lastStarted;           // number of the newest version being built or published
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        for (;;) {
+            std::vector<GraphDelta> batch;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]() { return stopping || !pending.empty(); });
+                if (stopping)
+                    return;
+                batch.swap(pending);
+                lastStarted++;
+            }
+            auto startTime = std::chrono::high_resolution_clock::now();
+            std::shared_ptr<const GraphVersion> base = load();
+            std::shared_ptr<const GraphVersion> next = merge(*base, batch);
+            std::atomic_store(&current, next);
+            if (published)
+                published(*next);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+            std::clog << "[" << getCurrentTimestamp() << "] Published graph version " << next->number << " ("
+                      << batch.size() << " updates) in " << formatDuration(elapsed) << "\n";
+        }
+    }
+
+public:
+    GraphUpdater(std::shared_ptr<const GraphVersion> initial, MergeFunction merge, PublishFunction published = nullptr)
+        : current(std::move(initial)), merge(std::move(merge)), published(std::move(published)), 
+          lastStarted(current->number) {
+        worker = std::thread(&GraphUpdater::run, this);
+    }
+
+    ~GraphUpdater() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    std::shared_ptr<const GraphVersion> load() const { return std::atomic_load(&current); }
+
+    // Queue a delta; returns the number of the version it will appear in
+    uint64_t submit(GraphDelta&& delta) {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending.push_back(std::move(delta));
+        cv.notify_one();
+        return lastStarted + 1;
+    }
+};
+
+// One request in flight. Walk requests split their start nodes into parts
+// that run on the worker pool; the worker finishing the last part completes
+// the response.
+struct WalkRequest {
+    int fd;
+    uint64_t id;
+    std::string command;
+    std::string client;                 // names the NodeManager cursor; empty for anonymous requests
+    std::string path;                   // triples file of ADD_TRIPLES / REMOVE_TRIPLES
+    std::shared_ptr<const GraphVersion> version;    // the graph this request walks
+    bool stream = false;
+    WalkFormat format = kFormatCsv;
+    int numWalks;
+    int walkLength;
+    WalkBias bias;
+    uint64_t seed;                      // walk streams are keyed by (seed, start node, attempt)
+    std::vector<NodeId> startNodes;
+    std::vector<std::string> partOutput;
+    std::atomic<int> pendingParts{0};
+    std::atomic<size_t> walkCount{0};
+    std::atomic<size_t> duplicateCount{0};
+    std::atomic<size_t> bytesSent{0};
+    std::mutex sendMutex;               // parts of a streamed request share the socket
+    std::atomic<bool> sendFailed{false};
+    std::chrono::high_resolution_clock::time_point received;
+};
+
+// Parse "GET_RANDOM_WALKS [numWalks [walkLength]] [KEY=VALUE...]",
+// "STREAM_RANDOM_WALKS [numWalks [walkLength [csv|bin]]] [KEY=VALUE...]",
+// "GET_DICTIONARY", "STATS" or "ADD_TRIPLES FILE" / "REMOVE_TRIPLES FILE",
+// where KEY is p, q, client or seed; missing values keep their defaults.
+// Returns false with a message in error when a walk count or length is out of
+// range, or p or q is unusable.
+bool parseWalkRequest(const std::string& text, WalkRequest& request, std::string& error) {
+    std::istringstream requestStream(text);
+    requestStream >> request.command;
+    if (request.command == "ADD_TRIPLES" || request.command == "REMOVE_TRIPLES") {
+        std::getline(requestStream >> std::ws, request.path);
+        while (!request.path.empty() && isBlank(request.path.back()))
+            request.path.pop_back();
+        return true;
+    }
+    request.stream = request.command == "STREAM_RANDOM_WALKS";
+    if (request.command != "GET_RANDOM_WALKS" && !request.stream)
+        return true;
+    double p = request.bias.p, q = request.bias.q;
+    int position = 0;
+    std::string token;
+    while (requestStream >> token) {
+        if (token.compare(0, 7, "client=") == 0) {
+            request.client = token.substr(7);
+        } else if (token.compare(0, 5, "seed=") == 0) {
+            request.seed = std::strtoull(token.c_str() + 5, nullptr, 10);
+        } else if (token.compare(0, 2, "p=") == 0 || token.compare(0, 2, "q=") == 0) {
+            double value = std::atof(token.c_str() + 2);
+            if (!validWalkBiasParam(value)) {
+                error = token.substr(0, 1) + " must be positive with a finite 1/" + token.substr(0, 1);
+                return false;
+            }
+            (token[0] == 'p' ? p : q) = value;
+        } else if (position == 0) {
+            request.numWalks = std::atoi(token.c_str());
+            position++;
+        } else if (position == 1) {
+            request.walkLength = std::atoi(token.c_str());
+            position++;
+        } else if (position == 2) {
+            request.format = token == "bin" ? kFormatBinary : kFormatCsv;
+            position++;
+        }
+    }
+    if (p != request.bias.p || q != request.bias.q)
+        request.bias = makeWalkBias(p, q);
+    if (request.numWalks <= 0 || request.numWalks > kMaxRequestWalks) {
+        error = "numWalks must be between 1 and " + std::to_string(kMaxRequestWalks);
+        return false;
+    }
+    if (request.walkLength <= 0 || request.walkLength > kMaxRequestWalkLength) {
+        error = "walkLength must be between 1 and " + std::to_string(kMaxRequestWalkLength);
+        return false;
+    }
+    return true;
+}
+
+bool sendAll(int fd, const char* data, size_t size, int flags = 0) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, flags | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool recvAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool sendFrame(int fd, FrameType type, const char* data, size_t size) {
+    unsigned char header[5];
+    uint32_t length = static_cast<uint32_t>(size);
+    header[0] = length >> 24;
+    header[1] = length >> 16;
+    header[2] = length >> 8;
+    header[3] = length;
+    header[4] = static_cast<unsigned char>(type);
+    return sendAll(fd, reinterpret_cast<const char*>(header), sizeof(header), size > 0 ? MSG_MORE : 0) &&
+           sendAll(fd, data, size);
+}
+
+// Send a frame of a streamed request; once the client has gone away, the
+// remaining frames are dropped
+void sendRequestFrame(WalkRequest& request, FrameType type, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(request.sendMutex);
+    if (request.sendFailed)
+        return;
+    PhaseTimer timer(kPhaseWrite);
+    if (sendFrame(request.fd, type, payload.data(), payload.size()))
+        request.bytesSent += payload.size() + 5;
+    else
+        request.sendFailed = true;
+    if (gMetricsEnabled)
+        threadMetrics().add(kCounterBytesWritten, payload.size() + 5);
+}
+
+void generateRequestPart(WalkRequest& request, size_t begin, size_t end, std::string& out) {
+    const Graph& graph = request.version->graph;
+    WalkHashSet seen;
+    WalkBatch batch;
+    for (size_t idx = begin; idx < end && !request.sendFailed; idx++) {
+        uint64_t dedupStart = gMetricsEnabled ? metricsClock() : 0;
+        size_t numWalks = generateDistinctWalks(graph, request.startNodes[idx], request.numWalks, request.walkLength, 
+                                                request.seed, request.bias, seen, batch);
+        uint64_t serializeStart = gMetricsEnabled ? metricsClock() : 0;
+        size_t steps = 0;
+        for (size_t i = 0; i < numWalks; i++) {
+            const NodeId* walk = batch.walk(i);
+            size_t walkSize = batch.walkSize(i);
+            steps += walkSize / 2;
+            if (request.format == kFormatBinary) {
+                uint32_t count = static_cast<uint32_t>(walkSize);
+                out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+                out.append(reinterpret_cast<const char*>(walk), walkSize * sizeof(NodeId));
+            } else {
+                for (size_t j = 0; j < walkSize; j++) {
+                    graph.dict.outputName(walk[j]).appendTo(out);
+                    out.push_back(j + 1 < walkSize ? ',' : '\n');
+                }
+            }
+        }
+        request.walkCount += numWalks;
+        // Count how many duplicate walks we had to handle
+        request.duplicateCount += request.numWalks - numWalks;
+        if (gMetricsEnabled) {
+            ThreadMetrics& metrics = threadMetrics();
+            metrics.record(kPhaseDedup, serializeStart - dedupStart);
+            metrics.record(kPhaseSerialize, metricsClock() - serializeStart);
+            metrics.add(kCounterWalks, numWalks);
+            metrics.add(kCounterSteps, steps);
+            metrics.add(kCounterDuplicates, request.numWalks - numWalks);
+        }
+        
+        // Streamed requests ship walks as soon as a frame's worth is ready
+        if (request.stream && out.size() >= kStreamFrameSize) {
+            sendRequestFrame(request, kFrameWalks, out);
+            out.clear();
+        }
+    }
+    if (request.stream && !out.empty()) {
+        sendRequestFrame(request, kFrameWalks, out);
+        out.clear();
+    }
+}
+
+void logRequestDone(const WalkRequest& request, const std::string& destination) {
+    std::chrono::duration<double> latency = std::chrono::high_resolution_clock::now() - request.received;
+    if (gMetricsEnabled) {
+        threadMetrics().record(kPhaseRequest, static_cast<uint64_t>(latency.count() * 1e9));
+        threadMetrics().add(kCounterRequests, 1);
+    }
+    double walkRate = request.walkCount / latency.count();
+    std::clog << "[" << getCurrentTimestamp() << "] Request " << request.id << ": generated " 
+              << request.walkCount << " walks to " << destination << " in " 
+              << formatDuration(latency) << " (" << static_cast<int>(walkRate) << " walks/sec, " 
+              << request.partOutput.size() << " parts)\n";
+    if (request.duplicateCount > 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Request " << request.id << ": handled " 
+                  << request.duplicateCount << " potential duplicate walks during generation\n";
+    }
+}
+
+// Complete a request once all of its parts are done: streamed requests get
+// the done frame, file requests get their parts written in order and the
+// absolute path of the file as the reply
+void finishWalkRequest(const ServerContext& context, WalkRequest& request) {
+    if (request.stream) {
+        sendRequestFrame(request, kFrameDone, std::string());
+        close(request.fd);
+        logRequestDone(request, request.sendFailed ? "a disconnected client" 
+                                                   : "the socket (" + formatBytes(request.bytesSent) + ")");
+        return;
+    }
+    
+    // Create unique filename based on timestamp and request number
+    auto now = std::chrono::system_clock::now();
+    auto nowMs = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
+    std::string timestamp = std::to_string(nowMs.time_since_epoch().count());
+    std::string outputFile = context.outputDir + "/walks_" + timestamp + "_" + std::to_string(request.id) 
+                           + (request.format == kFormatBinary ? ".bin" : ".csv");
+    
+    std::ofstream outFile(outputFile, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << outputFile << "\n";
+        std::string errorMsg = "ERROR: Could not create output file";
+        sendAll(request.fd, errorMsg.c_str(), errorMsg.size());
+        close(request.fd);
+        return;
+    }
+    {
+        PhaseTimer timer(kPhaseWrite);
+        size_t written = 0;
+        if (request.format == kFormatBinary) {
+            WalkFileHeader header = makeWalkFileHeader(request.version->graph.dict.size(), 
+                                                       request.version->dictionaryChecksum);
+            outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            written += sizeof(header);
+        }
+        for (const auto& part : request.partOutput) {
+            outFile.write(part.data(), part.size());
+            written += part.size();
+        }
+        outFile.close();
+        if (gMetricsEnabled)
+            threadMetrics().add(kCounterBytesWritten, written);
+    }
+    
+    // Send the file path as response
+    sendAll(request.fd, outputFile.c_str(), outputFile.size());
+    close(request.fd);
+    logRequestDone(request, outputFile);
+}
+
+// Stream the term dictionary (one term per line, line i = ID i) so that
+// clients of binary streams can decode IDs without access to the server's disk
+void streamDictionary(WalkRequest& request) {
+    const Dictionary& dict = request.version->graph.dict;
+    std::string out;
+    for (NodeId id = 0; id < dict.size() && !request.sendFailed; id++) {
+        dict.name(id).appendTo(out);
+        out.push_back('\n');
+        if (out.size() >= kStreamFrameSize) {
+            sendRequestFrame(request, kFrameTerms, out);
+            out.clear();
+        }
+    }
+    if (!out.empty())
+        sendRequestFrame(request, kFrameTerms, out);
+    sendRequestFrame(request, kFrameDone, std::string());
+    close(request.fd);
+    std::clog << "[" << getCurrentTimestamp() << "] Request " << request.id << ": sent " << dict.size() 
+              << " dictionary terms (" << formatBytes(request.bytesSent) << ")\n";
+}
+
+// Parse the triples file of an ADD_TRIPLES / REMOVE_TRIPLES request and queue
+// it; the reply names the graph version the change will be live in
+void queueGraphUpdate(GraphUpdater& updater, WalkRequest& request, int numThreads) {
+    bool remove = request.command == "REMOVE_TRIPLES";
+    GraphDelta delta;
+    std::string reply;
+    if (request.path.empty() || !loadGraphDelta(request.path, remove, numThreads, delta)) {
+        reply = "ERROR: Could not read triples from " + request.path;
+    } else {
+        size_t numTriples = delta.triples.size();
+        uint64_t version = updater.submit(std::move(delta));
+        reply = "OK: queued " + std::to_string(numTriples) + " triples to " + (remove ? "remove" : "add") 
+              + " for graph version " + std::to_string(version);
+    }
+    sendAll(request.fd, reply.c_str(), reply.size());
+    close(request.fd);
+    std::clog << "[" << getCurrentTimestamp() << "] Request " << request.id << " (" << request.command << " " 
+              << request.path << "): " << reply << "\n";
+}
+
+// Minimal HTTP listener for Prometheus scrapes, bound to 127.0.0.1: every
+// GET /metrics is answered with render(), anything else with 404. Scrapes
+// are rare and tiny, so one blocking thread serves them in turn; a client
+// gets about a second to send its request line, so an idle or slow
+// connection cannot hold up the scrapes behind it.
+void serveMetricsEndpoint(int port, std::function<std::string()> render) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Could not serve metrics on port " << port << "\n";
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Serving metrics on http://127.0.0.1:" << port << "/metrics\n";
+    char buffer[4096];
+    while (true) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        struct timeval timeout = {1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        // Only the request line matters; read until it is complete
+        std::string request;
+        ssize_t n;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (request.find('\n') == std::string::npos && request.size() < 8192 &&
+               std::chrono::steady_clock::now() < deadline && (n = read(client, buffer, sizeof(buffer))) > 0)
+            request.append(buffer, n);
+        bool found = request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0;
+        std::string body = found ? render() : "Not Found\n";
+        std::string response = std::string(found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n")
+                             + "Content-Type: text/plain; version=0.0.4\r\nContent-Length: " 
+                             + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        sendAll(client, response.data(), response.size());
+        close(client);
+    }
+}
+
+// Socket server: an epoll loop accepts connections and reads requests without
+// blocking, and the walks for each request are generated on a pool of
+// numThreads workers. A request's start nodes are fanned out over up to
+// numThreads parts, so one large request uses the whole pool while several
+// small ones are served side by side. GET_RANDOM_WALKS writes the walks to a
+// file under walks_output and replies with its path; STREAM_RANDOM_WALKS
+// sends them back over the connection in frames as they are generated.
+// ADD_TRIPLES / REMOVE_TRIPLES merge a triples file into the graph in the
+// background and publish the result as a new GraphVersion. STATS replies
+// with the metrics, which a metricsPort above 0 also serves over HTTP.
+void serveRandomWalks(Graph graph, int port, int defaultNumWalksPerNode, 
+                      int defaultWalkLength, const StartNodeOptions& startOptions, int numThreads,
+                      const WalkBias& bias, const std::vector<float>& predicateWeights, uint64_t seed, 
+                      WalkFormat format = kFormatCsv, int metricsPort = 0) {
+    int server_fd;
+    struct sockaddr_in address;
+    int opt = 1;
+    
+    // File responses go to walks_output, created once; binary ones share a
+    // sidecar dictionary per graph version (walks.dict, then walks.N.dict)
+    ServerContext context{format, bias, "walks_output"};
+    if (mkdir(context.outputDir.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::clog << "[" << getCurrentTimestamp() << "] Could not create " << context.outputDir << "\n";
+        return;
+    }
+    char resolved[PATH_MAX];
+    if (realpath(context.outputDir.c_str(), resolved))
+        context.outputDir = resolved;
+    
+    // Version 0 is the loaded graph. The node manager outlives every version:
+    // each one's start nodes are handed to it once the version is published,
+    // so client cursors carry on across updates.
+    auto initial = std::make_shared<GraphVersion>();
+    initial->graph = std::move(graph);
+    NodeManager nodeManager(getStartNodes(initial->graph, startOptions), mix64(seed));
+    if (format == kFormatBinary &&
+        !writeDictionaryFile(initial->graph, context.outputDir + "/walks.dict", initial->dictionaryChecksum))
+        return;
+    GraphUpdater updater(initial, [&](const GraphVersion& base, const std::vector<GraphDelta>& deltas) {
+        auto next = std::make_shared<GraphVersion>();
+        next->number = base.number + 1;
+        next->graph = applyGraphDeltas(base.graph, deltas, predicateWeights, numThreads);
+        if (format == kFormatBinary) {
+            writeDictionaryFile(next->graph, context.outputDir + "/walks." + std::to_string(next->number) + ".dict",
+                                next->dictionaryChecksum);
+        }
+        return next;
+    }, [&](const GraphVersion& version) { nodeManager.update(getStartNodes(version.graph, startOptions)); });
+    initial.reset();
+    
+    // Metrics plus gauges for the graph currently being served
+    auto renderMetrics = [&updater]() {
+        auto current = updater.load();
+        std::string text = gMetricsEnabled ? formatMetrics() : "# metrics are disabled; start the server with --metrics\n";
+        text += "# TYPE random_walker_graph_version gauge\nrandom_walker_graph_version " + std::to_string(current->number) 
+              + "\n# TYPE random_walker_graph_nodes gauge\nrandom_walker_graph_nodes " 
+              + std::to_string(current->graph.numNodes()) 
+              + "\n# TYPE random_walker_graph_edges gauge\nrandom_walker_graph_edges " 
+              + std::to_string(current->graph.numEdges()) + "\n";
+        return text;
+    };
+    if (metricsPort > 0)
+        std::thread(serveMetricsEndpoint, metricsPort, renderMetrics).detach();
+    
+    // Creating socket file descriptor
+    if ((server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Socket creation failed\n";
+        return;
+    }
+    
+    // Set socket options to reuse address and port
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
+        std::clog << "[" << getCurrentTimestamp() << "] setsockopt failed\n";
+        return;
+    }
+    
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    
+    // Bind the socket to the specified port
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Bind failed on port " << port << "\n";
+        return;
+    }
     
-    while (walks.size() < numWalks && attempts < numWalks * maxAttemptsPerWalk) {
-        auto walk = randomWalk(graph, startNode, walkLength, rng);
-        std::string walkStr = walkToString(walk);
+    // Listen for connections
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Listen failed\n";
+        return;
+    }
+    
+    int epoll_fd = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = server_fd;
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] epoll setup failed\n";
+        return;
+    }
+    
+    WorkerPool pool(numThreads);
+    std::unordered_map<int, std::string> pendingRequests;  // fd -> bytes received so far
+    std::unordered_map<int, std::chrono::high_resolution_clock::time_point> acceptTimes;
+    std::unordered_map<int, std::chrono::steady_clock::time_point> partialSince;  // fd -> last read of an unfinished line
+    uint64_t nextRequestId = 0;
+    
+    std::clog << "[" << getCurrentTimestamp() << "] Server started on port " << port 
+              << " with " << numThreads << " worker threads, waiting for connections...\n";
+    
+    auto dispatch = [&](int fd, const std::string& text) {
+        auto request = std::make_shared<WalkRequest>();
+        request->fd = fd;
+        request->id = nextRequestId++;
+        request->numWalks = defaultNumWalksPerNode;
+        request->walkLength = defaultWalkLength;
+        request->format = format;
+        request->bias = bias;
+        request->seed = mix64(seed + request->id);
+        request->received = acceptTimes[fd];
+        std::string error;
+        if (!parseWalkRequest(text, *request, error)) {
+            std::clog << "[" << getCurrentTimestamp() << "] Request " << request->id << " (" << request->command 
+                      << ") rejected: " << error << "\n";
+            pool.submit([request, error]() {
+                if (request->stream) {
+                    sendFrame(request->fd, kFrameError, error.data(), error.size());
+                } else {
+                    std::string reply = "ERROR: " + error;
+                    sendAll(request->fd, reply.data(), reply.size());
+                }
+                close(request->fd);
+            });
+            return;
+        }
         
-        attempts++;
+        if (request->command == "ADD_TRIPLES" || request->command == "REMOVE_TRIPLES") {
+            pool.submit([&updater, request, numThreads]() { queueGraphUpdate(updater, *request, numThreads); });
+            return;
+        }
+        if (request->command == "STATS") {
+            pool.submit([&renderMetrics, request]() {
+                std::string reply = renderMetrics();
+                sendAll(request->fd, reply.data(), reply.size());
+                close(request->fd);
+            });
+            return;
+        }
+        if (request->command == "GET_DICTIONARY") {
+            request->version = updater.load();
+            pool.submit([request]() { streamDictionary(*request); });
+            return;
+        }
         
-        // Check if this walk is already generated
-        if (walkStrings.find(walkStr) == walkStrings.end()) {
-            // New unique walk
-            walkStrings.insert(walkStr);
-            walks.push_back(walk);
-        } else {
-            // Duplicate walk found
-            duplicates++;
+        // Take the start nodes before the graph: start nodes are published
+        // after the version they come from, so the version loaded next has all
+        // of them
+        request->startNodes = nodeManager.getNextBatch(request->client);
+        request->version = updater.load();
+        
+        std::clog << "[" << getCurrentTimestamp() << "] Request " << request->id << " (" << request->command 
+                  << ") with parameters: numWalks=" << request->numWalks << ", walkLength=" << request->walkLength 
+                  << ", format=" << (request->format == kFormatBinary ? "bin" : "csv") 
+                  << ", p=" << request->bias.p << ", q=" << request->bias.q 
+                  << (request->client.empty() ? std::string() : ", client=" + request->client) 
+                  << ", seed=" << request->seed << "\n";
+        
+        if (request->stream && request->format == kFormatBinary) {
+            WalkFileHeader header = makeWalkFileHeader(request->version->graph.dict.size(), 
+                                                       request->version->dictionaryChecksum);
+            sendRequestFrame(*request, kFrameHeader, 
+                             std::string(reinterpret_cast<const char*>(&header), sizeof(header)));
+        }
+        
+        // Fan the start nodes out over the pool
+        size_t numNodes = request->startNodes.size();
+        size_t numParts = std::max<size_t>(1, std::min<size_t>(numThreads, numNodes));
+        request->partOutput.resize(numParts);
+        request->pendingParts = static_cast<int>(numParts);
+        for (size_t part = 0; part < numParts; part++) {
+            size_t begin = numNodes * part / numParts;
+            size_t end = numNodes * (part + 1) / numParts;
+            pool.submit([&context, request, begin, end, part]() {
+                generateRequestPart(*request, begin, end, request->partOutput[part]);
+                if (--request->pendingParts == 0)
+                    finishWalkRequest(context, *request);
+            });
+        }
+    };
+    
+    // The connection now belongs to the request; switch it back to blocking for the reply
+    auto takeRequest = [&](int fd) {
+        const std::string& received = pendingRequests[fd];
+        std::string text = received.substr(0, received.find('\n'));
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        dispatch(fd, text);
+        pendingRequests.erase(fd);
+        acceptTimes.erase(fd);
+        partialSince.erase(fd);
+    };
+    
+    std::vector<struct epoll_event> events(256);
+    char buffer[4096];
+    while (true) {
+        // Wake up in time to take requests whose newline never came
+        int timeout = -1;
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& partial : partialSince) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(partial.second + kRequestLineTimeout - now);
+            timeout = std::max<int>(0, timeout < 0 ? left.count() : std::min<int>(timeout, left.count()));
+        }
+        int numEvents = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), timeout);
+        if (numEvents < 0) {
+            if (errno != EINTR)
+                std::clog << "[" << getCurrentTimestamp() << "] epoll_wait failed\n";
+            continue;
+        }
+        for (int e = 0; e < numEvents; e++) {
+            int fd = events[e].data.fd;
+            if (fd == server_fd) {
+                // Accept every pending connection
+                for (;;) {
+                    int new_socket = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK);
+                    if (new_socket < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                            std::clog << "[" << getCurrentTimestamp() << "] Accept failed\n";
+                        break;
+                    }
+                    struct epoll_event clientEvent;
+                    clientEvent.events = EPOLLIN | EPOLLRDHUP;
+                    clientEvent.data.fd = new_socket;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_socket, &clientEvent);
+                    pendingRequests[new_socket].clear();
+                    acceptTimes[new_socket] = std::chrono::high_resolution_clock::now();
+                }
+                continue;
+            }
             
-            // If we have too many duplicates, we might have exhausted all possible unique paths
-            if (duplicates > numWalks * 2) {
-                std::clog << "[" << getCurrentTimestamp() << "] WARNING: High number of duplicate walks from node " 
-                          << startNode << ". Possibly limited path diversity.\n";
-                
-                // Accept some duplicates if we can't find enough unique walks
-                if (walks.size() < numWalks / 2) {
-                    walks.push_back(walk);
-                    std::clog << "[" << getCurrentTimestamp() << "] Accepting some duplicate walks to meet quota.\n";
+            // Read whatever the client has sent. A request is complete at a
+            // newline, when the client closes its end, or when nothing more
+            // arrives for kRequestLineTimeout (for clients that send the
+            // request without a terminator).
+            std::string& received = pendingRequests[fd];
+            bool closed = false;
+            for (;;) {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n > 0) {
+                    received.append(buffer, n);
+                } else if (n == 0) {
+                    closed = true;
+                    break;
+                } else {
+                    if (errno == EINTR)
+                        continue;
+                    closed = errno != EAGAIN && errno != EWOULDBLOCK;
+                    break;
                 }
             }
+            if (received.empty()) {
+                if (closed) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                    pendingRequests.erase(fd);
+                    acceptTimes.erase(fd);
+                    close(fd);
+                }
+                continue;
+            }
+            if (received.find('\n') == std::string::npos && !closed && received.size() < kMaxRequestLine) {
+                partialSince[fd] = std::chrono::steady_clock::now();
+                continue;
+            }
+            takeRequest(fd);
         }
         
-        // Log progress for excessive attempts
-        if (attempts % (numWalks * 2) == 0) {
-            std::clog << "[" << getCurrentTimestamp() << "] Generated " << walks.size() 
-                      << " unique walks after " << attempts << " attempts. Duplicates: " << duplicates << "\n";
+        std::vector<int> expired;
+        now = std::chrono::steady_clock::now();
+        for (const auto& partial : partialSince) {
+            if (now - partial.second >= kRequestLineTimeout)
+                expired.push_back(partial.first);
         }
+        for (int fd : expired)
+            takeRequest(fd);
     }
     
-    if (walks.size() < numWalks) {
-        std::clog << "[" << getCurrentTimestamp() << "] Could only generate " << walks.size() 
-                  << " unique walks out of " << numWalks << " requested from node " << startNode << "\n";
-    }
-    
-    return walks;
+    // Close the socket (this is unreachable in the current implementation)
+    close(epoll_fd);
+    close(server_fd);
 }
 
+// Sharded walks: every process (rank) holds the out-edges of the nodes that
+// hash to it and starts walks from those nodes. A walk that reaches a node
+// owned by another rank is sent there as a continuation record carrying the
+// path so far and the state of its RNG stream, so a sharded run with a fixed
+// seed produces the same walks as a single process. A walk that reaches a
+// node with no out-edge to take on any rank (a literal, say) ends where it is
+// instead; ranks swap bitmaps of the nodes they can step from when they
+// connect. Each rank writes the walks that end on it to its own output file. Rank 0 tracks how many walks
+// were started and finished everywhere and tells all ranks to stop once the
+// two match.
+struct ShardPeer {
+    std::string host;
+    int port;
+};
 
-void writeWalkToCSV(std::ofstream& file, const std::vector<std::string>& walk, std::mutex& mtx) {
-    std::stringstream ss;
-    for (size_t i = 0; i < walk.size(); i++) {
-        ss << walk[i];
-        if (i < walk.size() - 1)
-            ss << ",";
+// Fixed part of a continuation record, followed by `size` NodeIds of path
+struct ContinuationHeader {
+    NodeId start;
+    uint32_t index;
+    uint32_t block;
+    uint32_t position;
+    uint32_t remaining;
+    uint32_t size;
+};
+
+const size_t kShardBatchSize = 64 * 1024;
+
+// One TCP connection to every other rank in each direction: outgoing ones
+// carry this rank's frames, incoming ones are drained by a receiver thread
+// per peer into a shared inbox
+class ShardNetwork {
+private:
+    int rank;
+    int numRanks;
+    std::vector<int> outgoing;
+    std::vector<int> incoming;
+    std::vector<std::string> outbox;
+    std::unique_ptr<std::mutex[]> outboxMutex;  // guards outbox[r] and sends on outgoing[r]
+    std::deque<std::string> inbox;
+    std::mutex inboxMutex;
+    std::vector<std::thread> receivers;
+    std::atomic<bool> done{false};
+    // Rank 0 only: walks started and finished per rank
+    std::unique_ptr<std::atomic<uint64_t>[]> started;
+    std::unique_ptr<std::atomic<uint64_t>[]> finished;
+    std::atomic<int> startsKnown{0};
+    // Walkable-node bitmap of every peer, filled once by its receiver thread
+    std::vector<std::string> walkable;
+    std::atomic<int> walkableKnown{0};
+
+    void send(int peer, FrameType type, const std::string& payload) {
+        if (!sendFrame(outgoing[peer], type, payload.data(), payload.size()))
+            std::clog << "[" << getCurrentTimestamp() << "] Lost connection to rank " << peer << "\n";
+        bytesSent += payload.size() + 5;
     }
-    ss << "\n";
-    
-    std::lock_guard<std::mutex> lock(mtx);
-    file << ss.str();
-}
 
-void processWalks(const Graph& graph, const std::vector<std::string>& nodes, int numWalks, int walkLength, 
-                 std::mutex &mtx, int threadId, std::ofstream& outFile) {
-    std::mt19937 rng(static_cast<unsigned>(std::time(nullptr)) + threadId);
-    for (const auto& node : nodes) {
-        for (int i = 0; i < numWalks; i++) {
-            auto walk = randomWalk(graph, node, walkLength, rng);
-            
-            // Write to CSV file
-            writeWalkToCSV(outFile, walk, mtx);
-            
-            {
-                std::lock_guard<std::mutex> lock(mtx);
-                std::cout << "Random walk from " << node << ": ";
-                for (const auto& n : walk)
-                    std::cout << n << " ";
-                std::cout << "\n";
+    void receive(int peer) {
+        std::string payload;
+        for (;;) {
+            unsigned char header[5];
+            if (!recvAll(incoming[peer], reinterpret_cast<char*>(header), sizeof(header)))
+                return;
+            uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) | 
+                              (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+            payload.resize(length);
+            if (!recvAll(incoming[peer], &payload[0], length))
+                return;
+            uint64_t value = 0;
+            if (length == sizeof(value))
+                memcpy(&value, payload.data(), sizeof(value));
+            switch (static_cast<char>(header[4])) {
+            case kFrameContinuations: {
+                bytesReceived += length + 5;
+                std::lock_guard<std::mutex> lock(inboxMutex);
+                inbox.push_back(std::move(payload));
+                payload = std::string();
+                break;
+            }
+            case kFrameStarts:
+                started[peer] = value;
+                startsKnown++;
+                break;
+            case kFrameProgress:
+                finished[peer] = value;
+                break;
+            case kFrameDone:
+                done = true;
+                break;
+            case kFrameWalkable:
+                walkable[peer] = std::move(payload);
+                payload = std::string();
+                walkableKnown++;
+                break;
+            default:
+                break;
             }
         }
     }
-}
 
-void benchmarkRandomWalks(const Graph& graph, const std::string& startNode, int numWalks, int walkLength) {
-    std::mt19937 rng(static_cast<unsigned>(std::time(nullptr)));
-    
-    std::clog << "[" << getCurrentTimestamp() << "] Starting benchmark: " << numWalks 
-              << " random walks of length " << walkLength << " from node " << startNode << "\n";
-    
-    auto startTime = std::chrono::high_resolution_clock::now();
-    
-    int walksCompleted = 0;
-    for (int i = 0; i < numWalks; i++) {
-        auto walk = randomWalk(graph, startNode, walkLength, rng);
-        walksCompleted++;
-        
-        if (walksCompleted % 1000 == 0) {
-            auto currentTime = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> elapsed = currentTime - startTime;
-            double rate = walksCompleted / elapsed.count();
-            std::clog << "[" << getCurrentTimestamp() << "] Generated " << walksCompleted 
-                      << " walks... (" << static_cast<int>(rate) << " walks/sec)\n";
-        }
+    static std::string counterPayload(uint64_t value) {
+        return std::string(reinterpret_cast<const char*>(&value), sizeof(value));
     }
-    
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> totalTime = endTime - startTime;
-    double rate = numWalks / totalTime.count();
-    
-    std::clog << "[" << getCurrentTimestamp() << "] Benchmark complete: Generated " << numWalks 
-              << " random walks in " << formatDuration(totalTime) << "\n";
-    std::clog << "[" << getCurrentTimestamp() << "] Performance: " << static_cast<int>(rate) 
-              << " walks/sec\n";
-}
-
-// Buffer for efficient writing
-class WalkBuffer {
-private:
-    std::vector<std::string> buffer;
-    std::ofstream& outFile;
-    std::mutex& mtx;
-    size_t maxSize;
 
 public:
-    WalkBuffer(std::ofstream& file, std::mutex& mutex, size_t bufferSize = 10000) 
-        : outFile(file), mtx(mutex), maxSize(bufferSize) {
-        buffer.reserve(maxSize);
-    }
+    std::atomic<size_t> bytesSent{0};
+    std::atomic<size_t> bytesReceived{0};
 
-    void add(const std::string& line) {
-        buffer.push_back(line);
-        if (buffer.size() >= maxSize) {
-            flush();
+    ShardNetwork(int rank, int numRanks)
+        : rank(rank), numRanks(numRanks), outgoing(numRanks, -1), incoming(numRanks, -1), outbox(numRanks),
+          outboxMutex(new std::mutex[numRanks]), started(new std::atomic<uint64_t>[numRanks]), 
+          finished(new std::atomic<uint64_t>[numRanks]), walkable(numRanks) {
+        for (int r = 0; r < numRanks; r++) {
+            started[r] = 0;
+            finished[r] = 0;
         }
     }
 
-    void flush() {
-        if (buffer.empty()) return;
-        
-        std::string data;
-        for (const auto& line : buffer) {
-            data += line;
+    ~ShardNetwork() {
+        for (int fd : outgoing) {
+            if (fd >= 0)
+                close(fd);
         }
-        
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            outFile << data;
+        for (auto& receiver : receivers)
+            receiver.join();
+        for (int fd : incoming) {
+            if (fd >= 0)
+                close(fd);
         }
-        
-        buffer.clear();
     }
 
-    ~WalkBuffer() {
-        flush();
+    // Listen on this rank's port, connect to every other rank (retrying while
+    // they start up) and exchange rank numbers
+    bool connect(const std::vector<ShardPeer>& peers) {
+        int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int opt = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(peers[rank].port);
+        if (listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || 
+            listen(listenFd, numRanks) < 0) {
+            std::clog << "[" << getCurrentTimestamp() << "] Rank " << rank << " cannot listen on port " 
+                      << peers[rank].port << "\n";
+            if (listenFd >= 0)
+                close(listenFd);
+            return false;
+        }
+        
+        std::thread acceptor([&]() {
+            for (int accepted = 0; accepted < numRanks - 1; accepted++) {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd < 0 && errno != EINTR)
+                    return;  // the listening socket was shut down
+                int32_t peer;
+                if (fd < 0 || !recvAll(fd, reinterpret_cast<char*>(&peer), sizeof(peer)) || 
+                    peer < 0 || peer >= numRanks || incoming[peer] >= 0) {
+                    if (fd >= 0)
+                        close(fd);
+                    accepted--;
+                    continue;
+                }
+                incoming[peer] = fd;
+            }
+        });
+        
+        bool ok = true;
+        for (int peer = 0; peer < numRanks && ok; peer++) {
+            if (peer == rank)
+                continue;
+            struct sockaddr_in peerAddress;
+            memset(&peerAddress, 0, sizeof(peerAddress));
+            peerAddress.sin_family = AF_INET;
+            peerAddress.sin_port = htons(peers[peer].port);
+            if (inet_pton(AF_INET, peers[peer].host.c_str(), &peerAddress.sin_addr) <= 0) {
+                std::clog << "[" << getCurrentTimestamp() << "] Invalid address for rank " << peer << ": " 
+                          << peers[peer].host << "\n";
+                ok = false;
+                break;
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+            for (;;) {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                if (fd >= 0 && ::connect(fd, (struct sockaddr*)&peerAddress, sizeof(peerAddress)) == 0) {
+                    int32_t self = rank;
+                    sendAll(fd, reinterpret_cast<const char*>(&self), sizeof(self));
+                    outgoing[peer] = fd;
+                    break;
+                }
+                if (fd >= 0)
+                    close(fd);
+                if (std::chrono::steady_clock::now() > deadline) {
+                    std::clog << "[" << getCurrentTimestamp() << "] Could not reach rank " << peer << " at " 
+                              << peers[peer].host << ":" << peers[peer].port << "\n";
+                    ok = false;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+        // The acceptor returns once every other rank has connected, or when
+        // the listening socket is shut down after a failure
+        if (!ok)
+            shutdown(listenFd, SHUT_RDWR);
+        acceptor.join();
+        close(listenFd);
+        if (!ok)
+            return false;
+        for (int peer = 0; peer < numRanks; peer++) {
+            if (peer != rank)
+                receivers.emplace_back(&ShardNetwork::receive, this, peer);
+        }
+        return true;
     }
-};
 
-std::string walkToCSV(const std::vector<std::string>& walk) {
-    std::stringstream ss;
-    for (size_t i = 0; i < walk.size(); i++) {
-        ss << walk[i];
-        if (i < walk.size() - 1)
-            ss << ",";
+    // Queue a continuation record for a peer; full batches are sent right away
+    void forward(int peer, const char* record, size_t size) {
+        std::lock_guard<std::mutex> lock(outboxMutex[peer]);
+        outbox[peer].append(record, size);
+        if (outbox[peer].size() >= kShardBatchSize) {
+            send(peer, kFrameContinuations, outbox[peer]);
+            outbox[peer].clear();
+        }
     }
-    ss << "\n";
-    return ss.str();
-}
 
-void generateRandomWalks(const Graph& graph, const std::vector<std::string>& startNodes, 
-                         int numWalksPerNode, int walkLength, std::ofstream& outFile,
-                         int threadId, std::mutex& fileMutex, std::atomic<int>& walkCounter) {
-    
-    // Create RNG with unique seed per thread
-    std::mt19937 rng(static_cast<unsigned>(std::time(nullptr)) + threadId);
-    
-    // Create buffer for efficient writing
-    WalkBuffer buffer(outFile, fileMutex);
-    
-    int localWalks = 0;
-    for (const auto& node : startNodes) {
-        for (int i = 0; i < numWalksPerNode; i++) {
-            auto walk = randomWalk(graph, node, walkLength, rng);
-            buffer.add(walkToCSV(walk));
-            
-            localWalks++;
-            walkCounter++;
-            
-            // Periodic status update
-            if (walkCounter.load() % 10000 == 0) {
-                std::lock_guard<std::mutex> lock(fileMutex);
-                std::clog << "[" << getCurrentTimestamp() << "] Generated " << walkCounter.load() << " walks\n";
+    // Send every partial batch
+    void flush() {
+        for (int peer = 0; peer < numRanks; peer++) {
+            if (peer == rank)
+                continue;
+            std::lock_guard<std::mutex> lock(outboxMutex[peer]);
+            if (!outbox[peer].empty()) {
+                send(peer, kFrameContinuations, outbox[peer]);
+                outbox[peer].clear();
             }
         }
     }
-    
-    // Make sure to flush remaining walks
-    buffer.flush();
-}
 
-// Helper function to check if a node is a predicate
-// bool isPredicate(const std::string& node) {
-//     // You may need to customize this based on your knowledge of predicates in your graph
-//     // For example, if predicates always start with a specific prefix:
-//     return node.substr(0, 4) == "http" && node.find("property") != std::string::npos;
-//     // Or if you have a set of known predicates:
-//     // static const std::unordered_set<std::string> predicates = {"type", "subClassOf", ...};
-//     // return predicates.find(node) != predicates.end();
-// }
+    bool popInbox(std::string& batch) {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        if (inbox.empty())
+            return false;
+        batch = std::move(inbox.front());
+        inbox.pop_front();
+        return true;
+    }
 
-std::vector<std::string> getStartNodes(const Graph& graph, float sampleRate = 1.0) {
-    std::vector<std::string> nodes;
-    nodes.reserve(graph.size() * sampleRate);
-    
-    for (const auto& pair : graph) {
-        // Only include nodes that have neighbors and are not predicates
-        if (!pair.second.empty()) {
-            nodes.push_back(pair.first);
+    // Send this rank's walkable-node bitmap to every peer, wait for theirs and
+    // merge them into it. Ranks own disjoint nodes, so the union tells every
+    // rank whether any rank can step from a node.
+    void exchangeWalkable(std::vector<uint64_t>& words) {
+        std::string payload(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+        for (int peer = 0; peer < numRanks; peer++) {
+            if (peer == rank)
+                continue;
+            std::lock_guard<std::mutex> lock(outboxMutex[peer]);
+            send(peer, kFrameWalkable, payload);
+        }
+        while (walkableKnown < numRanks - 1)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (int peer = 0; peer < numRanks; peer++) {
+            if (peer == rank)
+                continue;
+            if (walkable[peer].size() != payload.size()) {
+                // Not the same dictionary: forward every walk rather than guess
+                std::clog << "[" << getCurrentTimestamp() << "] Rank " << peer << " sent a node bitmap of " 
+                          << walkable[peer].size() << " bytes, expected " << payload.size() << "\n";
+                std::fill(words.begin(), words.end(), ~0ULL);
+                return;
+            }
+            const char* bytes = walkable[peer].data();
+            for (size_t w = 0; w < words.size(); w++) {
+                uint64_t word;
+                memcpy(&word, bytes + w * sizeof(word), sizeof(word));
+                words[w] |= word;
+            }
+            walkable[peer] = std::string();
         }
     }
-    
-    // If sampling, shuffle and take a subset
-    if (sampleRate < 1.0) {
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(nodes.begin(), nodes.end(), g);
-        
-        size_t sampleSize = static_cast<size_t>(nodes.size() * sampleRate);
-        nodes.resize(sampleSize);
-    }
-    
-    return nodes;
-}
 
-void runParallelRandomWalks(const Graph& graph, const std::string& outputFile, 
-                           int numWalksPerNode, int walkLength, float nodeSampleRate, int numThreads) {
-    
-    std::clog << "[" << getCurrentTimestamp() << "] Starting parallel random walks generation\n";
-    auto startTime = std::chrono::high_resolution_clock::now();
-    
-    // Get nodes to start walks from
-    std::vector<std::string> startNodes = getStartNodes(graph, nodeSampleRate);
-    
-    std::clog << "[" << getCurrentTimestamp() << "] Selected " << startNodes.size() 
-              << " start nodes (sampling rate: " << nodeSampleRate << ")\n";
-    
-    // Open output file
-    std::ofstream outFile(outputFile);
-    if (!outFile.is_open()) {
-        std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << outputFile << "\n";
-        return;
-    }
-    
-    // Prepare for parallel execution
-    std::vector<std::thread> threads;
-    std::mutex fileMutex;
-    std::atomic<int> totalWalks{0};
-    
-    // Divide work among threads
-    size_t nodesPerThread = (startNodes.size() + numThreads - 1) / numThreads;
-    
-    for (int i = 0; i < numThreads; i++) {
-        size_t startIdx = i * nodesPerThread;
-        size_t endIdx = std::min(startIdx + nodesPerThread, startNodes.size());
-        
-        if (startIdx >= startNodes.size()) break;
-        
-        std::vector<std::string> threadNodes(startNodes.begin() + startIdx, startNodes.begin() + endIdx);
-        
-        threads.emplace_back(generateRandomWalks, std::ref(graph), std::ref(threadNodes),
-                            numWalksPerNode, walkLength, std::ref(outFile),
-                            i, std::ref(fileMutex), std::ref(totalWalks));
-    }
-    
-    // Wait for all threads to complete
-    for (auto& thread : threads) {
-        thread.join();
+    // Report this rank's totals to rank 0
+    void reportStarts(uint64_t count) {
+        if (rank == 0) {
+            started[0] = count;
+            startsKnown++;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(outboxMutex[0]);
+        send(0, kFrameStarts, counterPayload(count));
     }
-    
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> totalTime = endTime - startTime;
-    
-    std::clog << "[" << getCurrentTimestamp() << "] Random walks generation complete: Generated " 
-              << totalWalks << " walks in " << formatDuration(totalTime) << "\n";
-    
-    double rate = totalWalks / totalTime.count();
-    std::clog << "[" << getCurrentTimestamp() << "] Performance: " << static_cast<int>(rate) 
-              << " walks/sec\n";
-}
-
-// Class to manage used start nodes to ensure variety in responses
-class NodeManager {
-private:
-    std::vector<std::string> allNodes;
-    std::set<std::string> usedNodes;
-    std::mutex mtx;
-    std::mt19937 rng;
-    size_t batchSize;
-    float sampleRate;
 
-public:
-    NodeManager(const Graph& graph, float sampleRate = 1.0, size_t batchSize = 100) 
-        : batchSize(batchSize), sampleRate(sampleRate) {
-        
-        // Initialize with all nodes from graph
-        for (const auto& pair : graph) {
-            if (!pair.second.empty()) {
-                allNodes.push_back(pair.first);
-            }
+    void reportProgress(uint64_t count) {
+        if (rank == 0) {
+            finished[0] = count;
+            return;
         }
-        
-        // Seed the random number generator
-        std::random_device rd;
-        rng = std::mt19937(rd());
-        
-        std::clog << "[" << getCurrentTimestamp() << "] NodeManager initialized with " 
-                  << allNodes.size() << " potential start nodes\n";
+        std::lock_guard<std::mutex> lock(outboxMutex[0]);
+        send(0, kFrameProgress, counterPayload(count));
     }
-    
-    std::vector<std::string> getNextBatch() {
-        std::lock_guard<std::mutex> lock(mtx);
-        
-        // If we've used all nodes or close to it, reset the used nodes
-        if (usedNodes.size() >= allNodes.size() * 0.9) {
-            std::clog << "[" << getCurrentTimestamp() << "] Resetting used nodes list\n";
-            usedNodes.clear();
-        }
-        
-        // Create a pool of unused nodes to sample from
-        std::vector<std::string> unusedNodes;
-        for (const auto& node : allNodes) {
-            if (usedNodes.find(node) == usedNodes.end()) {
-                unusedNodes.push_back(node);
-            }
-        }
-        
-        // Apply sampling rate to the unused nodes
-        if (sampleRate < 1.0 && !unusedNodes.empty()) {
-            std::shuffle(unusedNodes.begin(), unusedNodes.end(), rng);
-            size_t sampleSize = std::max(size_t(1), static_cast<size_t>(unusedNodes.size() * sampleRate));
-            unusedNodes.resize(sampleSize);
+
+    // Rank 0: once every walk started anywhere has finished somewhere, tell
+    // all ranks to stop
+    bool checkCompletion() {
+        if (rank != 0 || startsKnown < numRanks)
+            return false;
+        uint64_t totalStarted = 0, totalFinished = 0;
+        for (int r = 0; r < numRanks; r++) {
+            totalStarted += started[r];
+            totalFinished += finished[r];
         }
-        
-        // Select up to batchSize nodes
-        std::vector<std::string> batch;
-        size_t count = std::min(batchSize, unusedNodes.size());
-        
-        if (!unusedNodes.empty()) {
-            // Shuffle and take the first 'count' elements
-            std::shuffle(unusedNodes.begin(), unusedNodes.end(), rng);
-            batch.assign(unusedNodes.begin(), unusedNodes.begin() + count);
-            
-            // Mark these nodes as used
-            for (const auto& node : batch) {
-                usedNodes.insert(node);
-            }
+        if (totalFinished < totalStarted)
+            return false;
+        for (int peer = 1; peer < numRanks; peer++) {
+            std::lock_guard<std::mutex> lock(outboxMutex[peer]);
+            send(peer, kFrameDone, std::string());
         }
-        
-        std::clog << "[" << getCurrentTimestamp() << "] Returning batch of " 
-                  << batch.size() << " nodes (" << usedNodes.size() << "/" 
-                  << allNodes.size() << " used so far)\n";
-                  
-        return batch;
+        done = true;
+        return true;
     }
+
+    bool isDone() const { return done.load(); }
 };
 
-// Structure for socket-based server
-void serveRandomWalks(const Graph& graph, int port, int defaultNumWalksPerNode, 
-                      int defaultWalkLength, float nodeSampleRate, int numThreads) {
-    int server_fd, new_socket;
-    struct sockaddr_in address;
-    int opt = 1;
-    int addrlen = sizeof(address);
-    char buffer[1024] = {0};
-    
-    // Create the node manager
-    NodeManager nodeManager(graph, nodeSampleRate);
-    
-    // Creating socket file descriptor
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        std::clog << "[" << getCurrentTimestamp() << "] Socket creation failed\n";
-        return;
+// Bitmap of the nodes this rank can take a step from: those with an
+// out-edge here, and with predicate weights one whose weight is not 0
+std::vector<uint64_t> walkableNodes(const Graph& graph) {
+    size_t numNodes = graph.numNodes();
+    std::vector<uint64_t> words((numNodes + 63) / 64, 0);
+    for (size_t node = 0; node < numNodes; node++) {
+        if (graph.degree(static_cast<NodeId>(node)) > 0 && 
+            (!graph.weighted() || graph.aliasIndex[graph.offsets[node]] != kNoEdge))
+            words[node / 64] |= 1ULL << (node % 64);
     }
-    
-    // Set socket options to reuse address and port
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
-        std::clog << "[" << getCurrentTimestamp() << "] setsockopt failed\n";
-        return;
+    return words;
+}
+
+// Take steps of a walk while it stays on this rank. Returns the rank that
+// owns the walk's current node, or -1 once the walk is complete; a walk at a
+// node that no rank can step from is complete wherever it is.
+int advanceShardWalk(const Graph& graph, int rank, int numRanks, const std::vector<uint64_t>& walkable, 
+                     WalkRng& rng, std::vector<NodeId>& path, uint32_t& remaining) {
+    for (;;) {
+        if (remaining == 0)
+            return -1;
+        NodeId current = path.back();
+        int owner = shardOf(current, numRanks);
+        if (owner != rank)
+            return walkable[current / 64] >> (current % 64) & 1 ? owner : -1;
+        uint32_t choice = sampleEdge(graph, current, rng);
+        if (choice == kNoEdge)
+            return -1;
+        const Edge& edge = graph.edgesOf(current)[choice];
+        path.push_back(edge.predicate);
+        path.push_back(edge.target);
+        remaining--;
     }
+}
+
+void runShardedRandomWalks(const Graph& graph, const std::vector<ShardPeer>& peers, int rank, 
+                           const std::string& outputFile, int numWalksPerNode, int walkLength, 
+                           const StartNodeOptions& startOptions, int numThreads, uint64_t seed, 
+                           WalkFormat format = kFormatCsv) {
+    int numRanks = static_cast<int>(peers.size());
+    std::string shardFile = outputFile + "." + std::to_string(rank);
+    auto startTime = std::chrono::high_resolution_clock::now();
     
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
+    // Nodes owned by other ranks have no out-edges here, so only local nodes are picked
+    std::vector<NodeId> startNodes = getStartNodes(graph, startOptions);
+    uint64_t numStarted = static_cast<uint64_t>(startNodes.size()) * numWalksPerNode;
+    std::clog << "[" << getCurrentTimestamp() << "] Rank " << rank << "/" << numRanks << ": " << startNodes.size() 
+              << " start nodes, " << graph.numEdges() << " local edges\n";
     
-    // Bind the socket to the specified port
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        std::clog << "[" << getCurrentTimestamp() << "] Bind failed on port " << port << "\n";
+    uint64_t dictionaryChecksum = 0;
+    if (format == kFormatBinary && !writeDictionaryFile(graph, shardFile + ".dict", dictionaryChecksum))
         return;
+    int outFd = ::open(shardFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << shardFile << "\n";
+        return;
+    }
+    if (format == kFormatBinary) {
+        WalkFileHeader header = makeWalkFileHeader(graph.dict.size(), dictionaryChecksum);
+        if (::write(outFd, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+            std::clog << "[" << getCurrentTimestamp() << "] Error writing output file: " << shardFile << "\n";
+            ::close(outFd);
+            return;
+        }
     }
     
-    // Listen for connections
-    if (listen(server_fd, 3) < 0) {
-        std::clog << "[" << getCurrentTimestamp() << "] Listen failed\n";
+    ShardNetwork network(rank, numRanks);
+    if (!network.connect(peers)) {
+        ::close(outFd);
         return;
     }
+    network.reportStarts(numStarted);
+    std::clog << "[" << getCurrentTimestamp() << "] Rank " << rank << " connected to " << numRanks - 1 << " peers\n";
+    std::vector<uint64_t> walkable = walkableNodes(graph);
+    network.exchangeWalkable(walkable);
+    auto walkStart = std::chrono::high_resolution_clock::now();
     
-    std::clog << "[" << getCurrentTimestamp() << "] Server started on port " << port 
-              << ", waiting for connections...\n";
+    WalkWriter writer(outFd, 3 * numThreads + 2, 1 << 20);
+    size_t grainSize = std::max<size_t>(1, std::min<size_t>(256, startNodes.size() / (numThreads * 32)));
+    WorkStealingScheduler scheduler(startNodes.size(), grainSize, numThreads);
+    std::atomic<uint64_t> numFinished{0};
+    std::atomic<size_t> recordsSent{0}, recordsReceived{0};
     
-    while (true) {
-        // Accept a new connection
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-            std::clog << "[" << getCurrentTimestamp() << "] Accept failed\n";
-            continue;
-        }
-        
-        std::clog << "[" << getCurrentTimestamp() << "] New connection accepted\n";
+    auto worker = [&](int threadId) {
+        WalkEmitter out(writer);
+        std::vector<NodeId> path;
+        std::string record, batch;
+        path.reserve(walkBufferSize(walkLength));
         
-        // Read request
-        int valread = read(new_socket, buffer, 1024);
-        if (valread <= 0) {
-            close(new_socket);
-            continue;
-        }
-        
-        // Parse request (expected format: "GET_RANDOM_WALKS numWalks walkLength")
-        std::string request(buffer);
-        std::istringstream requestStream(request);
-        std::string command;
-        int numWalks = defaultNumWalksPerNode;
-        int walkLength = defaultWalkLength;
-        
-        requestStream >> command;
-        if (command == "GET_RANDOM_WALKS") {
-            // Try to parse numWalks and walkLength if provided
-            if (requestStream >> numWalks) {
-                if (!(requestStream >> walkLength)) {
-                    walkLength = defaultWalkLength;
-                }
-            } else {
-                numWalks = defaultNumWalksPerNode;
+        // Finish the walk locally or hand it to the rank that owns its current node
+        auto advance = [&](WalkRng& rng, NodeId start, uint32_t index, uint32_t remaining) {
+            int owner = advanceShardWalk(graph, rank, numRanks, walkable, rng, path, remaining);
+            if (owner < 0) {
+                emitWalk(out, format, graph, path.data(), path.size());
+                numFinished.fetch_add(1, std::memory_order_relaxed);
+                return;
             }
-        }
-        
-        std::clog << "[" << getCurrentTimestamp() << "] Received request with parameters: "
-                  << "numWalks=" << numWalks << ", walkLength=" << walkLength << "\n";
+            ContinuationHeader header{start, index, rng.blockCounter(), static_cast<uint32_t>(rng.outputPosition()), 
+                                      remaining, static_cast<uint32_t>(path.size())};
+            record.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+            record.append(reinterpret_cast<const char*>(path.data()), path.size() * sizeof(NodeId));
+            network.forward(owner, record.data(), record.size());
+            recordsSent.fetch_add(1, std::memory_order_relaxed);
+        };
         
-        // Create unique filename based on timestamp
-        auto now = std::chrono::system_clock::now();
-        auto nowMs = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
-        auto epoch = nowMs.time_since_epoch();
-        auto value = std::chrono::duration_cast<std::chrono::milliseconds>(epoch);
-        std::string timestamp = std::to_string(value.count());
-        
-        std::string outputDir = "walks_output";
-        system(("mkdir -p " + outputDir).c_str());
-        std::string outputFile = outputDir + "/walks_" + timestamp + ".csv";
-        std::clog << "[" << getCurrentTimestamp() << "] Creating output file: " << outputFile << "\n";
-        
-        // Get a new batch of start nodes
-        std::vector<std::string> startNodes = nodeManager.getNextBatch();
-        
-        // Open output file
-        std::ofstream outFile(outputFile);
-        if (!outFile.is_open()) {
-            std::clog << "[" << getCurrentTimestamp() << "] Error opening output file: " << outputFile << "\n";
-            std::string errorMsg = "ERROR: Could not create output file";
-            send(new_socket, errorMsg.c_str(), errorMsg.size(), 0);
-            close(new_socket);
-            continue;
-        }
-        
-        // Start timing the walk generation
-        auto walkGenStart = std::chrono::high_resolution_clock::now();
-        
-        // Generate walks for this batch and write to file
-        std::mt19937 rng(static_cast<unsigned>(std::time(nullptr)));
-        int walkCount = 0;
-        int duplicateCount = 0;
-        
-        for (const auto& node : startNodes) {
-            // Track distinct walks for this node
-            std::set<std::string> nodeWalks;
-            
-            // Generate distinct walks for this node
-            auto walks = generateDistinctWalks(graph, node, numWalks, walkLength, rng);
-            
-            // Write walks to file
-            for (const auto& walk : walks) {
-                // Write walk to CSV file
-                for (size_t j = 0; j < walk.size(); j++) {
-                    outFile << walk[j];
-                    if (j < walk.size() - 1) outFile << ",";
+        WalkTask task;
+        bool stolen;
+        int idleRounds = 0;
+        for (;;) {
+            if (network.popInbox(batch)) {
+                idleRounds = 0;
+                size_t offset = 0;
+                while (offset + sizeof(ContinuationHeader) <= batch.size()) {
+                    ContinuationHeader header;
+                    memcpy(&header, batch.data() + offset, sizeof(header));
+                    offset += sizeof(header);
+                    path.resize(header.size);
+                    memcpy(path.data(), batch.data() + offset, header.size * sizeof(NodeId));
+                    offset += header.size * sizeof(NodeId);
+                    WalkRng rng(seed, header.start, header.index, header.block, static_cast<int>(header.position));
+                    advance(rng, header.start, header.index, header.remaining);
+                    recordsReceived.fetch_add(1, std::memory_order_relaxed);
+                }
+            } else if (scheduler.next(threadId, task, stolen)) {
+                idleRounds = 0;
+                for (size_t idx = task.begin; idx < task.end; idx++) {
+                    NodeId node = startNodes[idx];
+                    for (int i = 0; i < numWalksPerNode; i++) {
+                        WalkRng rng(seed, node, i);
+                        path.assign(1, node);
+                        advance(rng, node, i, walkLength > 1 ? walkLength - 1 : 0);
+                    }
                 }
-                outFile << "\n";
-                walkCount++;
+            } else if (network.isDone()) {
+                break;
+            } else {
+                backoff(idleRounds);
             }
-            
-            // Count how many duplicate walks we had to handle
-            duplicateCount += (numWalks - walks.size());
         }
-        
-        outFile.close();
-        
-        // End timing and calculate duration
-        auto walkGenEnd = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> walkGenTime = walkGenEnd - walkGenStart;
-        double walkRate = walkCount / walkGenTime.count();
-        
-        // Send the file path as response
-        std::string absolutePath = std::string("/gpfs/workdir/mortadii/GraphTwin-ai/") + outputFile;
-        send(new_socket, absolutePath.c_str(), absolutePath.size(), 0);
-        
-        std::clog << "[" << getCurrentTimestamp() << "] Generated and saved " 
-                  << walkCount << " walks to " << outputFile << " in " 
-                  << formatDuration(walkGenTime) << " (" 
-                  << static_cast<int>(walkRate) << " walks/sec)\n";
-                  
-        if (duplicateCount > 0) {
-            std::clog << "[" << getCurrentTimestamp() << "] Handled " << duplicateCount 
-                      << " potential duplicate walks during generation\n";
+        out.flush();
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back(worker, i);
+    }
+    
+    // Ship partial batches and progress every few milliseconds until rank 0
+    // sees every walk finished
+    uint64_t reported = std::numeric_limits<uint64_t>::max();
+    while (!network.isDone()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        network.flush();
+        uint64_t current = numFinished.load();
+        if (current != reported) {
+            network.reportProgress(current);
+            reported = current;
         }
-                  
-        close(new_socket);
+        network.checkCompletion();
+    }
+    for (auto& thread : threads) {
+        thread.join();
     }
+    writer.finish();
+    ::close(outFd);
     
-    // Close the socket (this is unreachable in the current implementation)
-    close(server_fd);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> totalTime = endTime - startTime;
+    std::chrono::duration<double> walkTime = endTime - walkStart;
+    std::clog << "[" << getCurrentTimestamp() << "] Rank " << rank << ": started " << numStarted << " walks, wrote " 
+              << numFinished << " to " << shardFile << " (" << formatBytes(writer.bytes()) << ") in " 
+              << formatDuration(totalTime) << "\n";
+    std::clog << "[" << getCurrentTimestamp() << "] Rank " << rank << ": forwarded " << recordsSent << " walks ("
+              << formatBytes(network.bytesSent) << " sent), received " << recordsReceived << " ("
+              << formatBytes(network.bytesReceived) << "); " 
+              << static_cast<int>(numFinished / walkTime.count()) << " walks/sec\n";
 }
 
 void printUsage(const char* programName) {
@@ -703,9 +5458,40 @@ void printUsage(const char* programName) {
               << "  -w, --walks N         Number of walks per node (default: 10)\n"
               << "  -l, --length N        Length of each walk (default: 15)\n"
               << "  -s, --sample RATE     Sampling rate for start nodes (0.0-1.0, default: 1.0)\n"
+              << "      --stratify KEYS   Sample start nodes per stratum: degree, type or degree,type\n"
+              << "      --per-stratum N   Start nodes drawn from each stratum (default: 1000)\n"
+              << "      --seed-nodes FILE Start only from the nodes listed in FILE (first CSV column, e.g. data/alignments.csv)\n"
               << "  -t, --threads N       Number of threads (default: 4)\n"
+              << "      --seed N          Seed for start-node sampling and walks; output is then identical for any -t\n"
               << "  -S, --server          Run as a server serving random walks over a socket\n"
               << "  -p, --port N          Port number for server mode (default: 8080)\n"
+              << "      --metrics         Record per-phase latency histograms and counters; logged at the end of a\n"
+              << "                        run, and sent in reply to STATS in server mode\n"
+              << "      --metrics-port N  Server mode: also serve them at http://127.0.0.1:N/metrics (implies --metrics)\n"
+              << "      --peers LIST      Sharded mode: comma-separated host:port of every rank, in rank order\n"
+              << "      --rank R          This process's rank in --peers; walks go to OUTPUT.R\n"
+              << "      --pg-edges FILE   Load a property graph edges CSV (start,end,type,...) instead of --file\n"
+              << "      --pg-nodes FILE   Property graph nodes CSV; its columns and JSON properties become extra hops,\n"
+              << "                        and edges with properties pass through a pg:START-TYPE-END node holding\n"
+              << "                        theirs (without --pg-nodes, edge properties are ignored)\n"
+              << "      --align FILE      Aligned mode: load --file and --pg-edges together and write WALKS walks\n"
+              << "                        from both sides of every rdf_uri,pg_id pair in FILE, one tab-separated\n"
+              << "                        RDF/PG line per walk (e.g. data/alignments.csv)\n"
+              << "      --save-snapshot FILE  Write the loaded graph to a binary snapshot\n"
+              << "      --load-snapshot FILE  Map a binary snapshot instead of parsing --file\n"
+              << "      --format FMT      Walk output format: csv, bin (uint32 IDs + FILE.dict), text (the\n"
+              << "                        \"DATE RANDOM WALK (length=N): a -> b\" lines of random_walk.sh) or tokens;\n"
+              << "                        default: csv\n"
+              << "      --tokenizer MODEL BPE model from src/tokenizer (CEGATokenize.save) for --format tokens, which\n"
+              << "                        writes packed token IDs ready for training\n"
+              << "      --curies          Write well-known IRIs as prefix:local (dbr:Berlin) in csv, text and tokens\n"
+              << "      --min-length N    Draw each walk's length uniformly from N to --length (random_walk.sh: 8 to 15)\n"
+              << "      --decode FILE     Convert a binary walk file to CSV (written to --output, - for stdout) and exit\n"
+              << "      --dict FILE       Dictionary for --decode (default: FILE.dict)\n"
+              << "      --p P             node2vec return parameter (default: 1)\n"
+              << "      --q Q             node2vec in-out parameter (default: 1; p = q = 1 is a plain walk)\n"
+              << "      --predicate-weights FILE  Sample out-edges by predicate weight (\"<predicate> weight\" lines)\n"
+              << "  -B, --benchmark       Benchmark the walk kernels on a synthetic skewed graph and exit\n"
               << "  -h, --help            Show this help message\n";
 }
 
@@ -717,10 +5503,30 @@ int main(int argc, char* argv[]) {
     std::string outputFile = "walks.csv";
     int numWalksPerNode = 10;
     int walkLength = 15;
-    float nodeSampleRate = 1.0;
+    int minWalkLength = 0;
+    double returnParam = 1.0;
+    double inOutParam = 1.0;
+    StartNodeOptions startOptions;
+    uint64_t seed = 0;
+    bool seedGiven = false;
+    bool curies = false;
+    std::vector<ShardPeer> peers;
+    int rank = 0;
     int numThreads = 4;
     bool serverMode = false;
+    bool benchmark = false;
     int port = 8080;
+    int metricsPort = 0;
+    WalkFormat format = kFormatCsv;
+    std::string decodeFile;
+    std::string dictionaryFile;
+    std::string tokenizerFile;
+    std::string saveSnapshotFile;
+    std::string predicateWeightsFile;
+    std::string loadSnapshotFile;
+    std::string pgNodesFile;
+    std::string pgEdgesFile;
+    std::string alignmentFile;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -737,14 +5543,87 @@ int main(int argc, char* argv[]) {
             numWalksPerNode = std::atoi(argv[++i]);
         } else if ((arg == "-l" || arg == "--length") && i + 1 < argc) {
             walkLength = std::atoi(argv[++i]);
+        } else if (arg == "--min-length" && i + 1 < argc) {
+            minWalkLength = std::atoi(argv[++i]);
         } else if ((arg == "-s" || arg == "--sample") && i + 1 < argc) {
-            nodeSampleRate = std::atof(argv[++i]);
+            startOptions.sampleRate = std::atof(argv[++i]);
+        } else if (arg == "--stratify" && i + 1 < argc) {
+            std::string keys = argv[++i];
+            startOptions.byDegree = keys.find("degree") != std::string::npos;
+            startOptions.byType = keys.find("type") != std::string::npos;
+            if (!startOptions.stratified()) {
+                std::cerr << "Unknown strata: " << keys << "\n";
+                return 1;
+            }
+        } else if (arg == "--per-stratum" && i + 1 < argc) {
+            startOptions.perStratum = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seed-nodes" && i + 1 < argc) {
+            startOptions.seedFile = argv[++i];
         } else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
             numThreads = std::atoi(argv[++i]);
+        } else if (arg == "-B" || arg == "--benchmark") {
+            benchmark = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+            seedGiven = true;
+        } else if (arg == "--peers" && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            std::string peer;
+            while (std::getline(list, peer, ',')) {
+                size_t colon = peer.rfind(':');
+                if (colon == std::string::npos) {
+                    std::cerr << "Peers must be host:port: " << peer << "\n";
+                    return 1;
+                }
+                peers.push_back({peer.substr(0, colon), std::atoi(peer.c_str() + colon + 1)});
+            }
+        } else if (arg == "--rank" && i + 1 < argc) {
+            rank = std::atoi(argv[++i]);
         } else if (arg == "-S" || arg == "--server") {
             serverMode = true;
         } else if ((arg == "-p" || arg == "--port") && i + 1 < argc) {
             port = std::atoi(argv[++i]);
+        } else if (arg == "--metrics") {
+            gMetricsEnabled = true;
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metricsPort = std::atoi(argv[++i]);
+            gMetricsEnabled = true;
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value == "bin") {
+                format = kFormatBinary;
+            } else if (value == "text") {
+                format = kFormatText;
+            } else if (value == "tokens") {
+                format = kFormatTokens;
+            } else if (value != "csv") {
+                std::cerr << "Unknown format: " << value << "\n";
+                return 1;
+            }
+        } else if (arg == "--curies") {
+            curies = true;
+        } else if (arg == "--decode" && i + 1 < argc) {
+            decodeFile = argv[++i];
+        } else if (arg == "--tokenizer" && i + 1 < argc) {
+            tokenizerFile = argv[++i];
+        } else if (arg == "--dict" && i + 1 < argc) {
+            dictionaryFile = argv[++i];
+        } else if (arg == "--p" && i + 1 < argc) {
+            returnParam = std::atof(argv[++i]);
+        } else if (arg == "--q" && i + 1 < argc) {
+            inOutParam = std::atof(argv[++i]);
+        } else if (arg == "--predicate-weights" && i + 1 < argc) {
+            predicateWeightsFile = argv[++i];
+        } else if (arg == "--pg-nodes" && i + 1 < argc) {
+            pgNodesFile = argv[++i];
+        } else if (arg == "--pg-edges" && i + 1 < argc) {
+            pgEdgesFile = argv[++i];
+        } else if (arg == "--align" && i + 1 < argc) {
+            alignmentFile = argv[++i];
+        } else if (arg == "--save-snapshot" && i + 1 < argc) {
+            saveSnapshotFile = argv[++i];
+        } else if (arg == "--load-snapshot" && i + 1 < argc) {
+            loadSnapshotFile = argv[++i];
         } else {
             std::cerr << "Unknown option: " << arg << "\n";
             printUsage(argv[0]);
@@ -752,29 +5631,124 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    numThreads = std::max(1, numThreads);
+    if (!validWalkBiasParam(returnParam) || !validWalkBiasParam(inOutParam)) {
+        std::cerr << "--p and --q must be positive, with finite 1/p and 1/q\n";
+        return 1;
+    }
+    WalkBias bias = makeWalkBias(returnParam, inOutParam);
+    if (!seedGiven) {
+        std::random_device rd;
+        seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    startOptions.seed = seed;
+    bool sharded = peers.size() > 1;
+    if (sharded && (rank < 0 || rank >= static_cast<int>(peers.size()) || serverMode || bias.secondOrder())) {
+        std::cerr << "Sharded mode needs a --rank within --peers, and does not support --server, --p or --q\n";
+        return 1;
+    }
+    if ((minWalkLength > 0 || format == kFormatText || format == kFormatTokens) && 
+        (sharded || serverMode || !alignmentFile.empty())) {
+        std::cerr << "--min-length and --format text/tokens are only supported when writing walks to a single file\n";
+        return 1;
+    }
+    if ((format == kFormatTokens) != !tokenizerFile.empty()) {
+        std::cerr << "--format tokens and --tokenizer go together\n";
+        return 1;
+    }
+    bool aligned = !alignmentFile.empty();
+    if (aligned && (pgEdgesFile.empty() || sharded || serverMode || format != kFormatCsv)) {
+        std::cerr << "--align needs --pg-edges, and does not support --peers, --server or --format bin\n";
+        return 1;
+    }
+    if (benchmark) {
+        benchmarkWalkKernels(numWalksPerNode * 10000, walkLength);
+        return 0;
+    }
+    std::clog << "[" << getCurrentTimestamp() << "] Using seed " << seed << (seedGiven ? "" : " (pass --seed to reproduce)") << "\n";
+    
+    if (!decodeFile.empty()) {
+        return decodeWalkFile(decodeFile, dictionaryFile.empty() ? decodeFile + ".dict" : dictionaryFile, outputFile) ? 0 : 1;
+    }
+    
     // Load the graph
     auto graphLoadStart = std::chrono::high_resolution_clock::now();
-    Graph graph = loadGraph(inputFile);
+    int numShards = sharded ? static_cast<int>(peers.size()) : 1;
+    Graph graph = !loadSnapshotFile.empty() ? loadGraphSnapshot(loadSnapshotFile)
+                : !pgEdgesFile.empty() && !aligned ? loadPropertyGraph(pgNodesFile, pgEdgesFile, !pgNodesFile.empty(), numThreads, 
+                                                           rank, numShards)
+                : loadGraph(inputFile, numThreads, rank, numShards);
+    if (sharded && !loadSnapshotFile.empty())
+        restrictToShard(graph, rank, numShards);
+    // In aligned mode the RDF graph above is joined by the property graph
+    Graph pgGraph;
+    if (aligned) {
+        pgGraph = loadPropertyGraph(pgNodesFile, pgEdgesFile, !pgNodesFile.empty(), numThreads);
+        if (pgGraph.empty()) {
+            std::clog << "[" << getCurrentTimestamp() << "] Property graph is empty. Exiting.\n";
+            return 1;
+        }
+    }
     auto graphLoadEnd = std::chrono::high_resolution_clock::now();
     
     std::chrono::duration<double> graphLoadTime = graphLoadEnd - graphLoadStart;
     std::clog << "[" << getCurrentTimestamp() << "] Graph loading completed in " << formatDuration(graphLoadTime) << "\n";
     
-    if (graph.empty()) {
+    // A shard may own no edges, but it still has to take part in the run
+    if (sharded ? graph.numNodes() == 0 : graph.empty()) {
         std::clog << "[" << getCurrentTimestamp() << "] Graph is empty. Exiting.\n";
         return 1;
     }
     
-    std::clog << "[" << getCurrentTimestamp() << "] Graph has " << graph.size() << " nodes\n";
+    if (!saveSnapshotFile.empty() && !saveGraphSnapshot(graph, saveSnapshotFile)) {
+        return 1;
+    }
+    
+    graph.dict.useCuries(curies);
+    pgGraph.dict.useCuries(curies);
+    
+    std::vector<float> predicateWeights;
+    if (!predicateWeightsFile.empty()) {
+        if (!loadPredicateWeights(graph, predicateWeightsFile, predicateWeights))
+            return 1;
+        buildAliasTables(graph, predicateWeights, numThreads);
+        if (aligned) {
+            if (!loadPredicateWeights(pgGraph, predicateWeightsFile, predicateWeights))
+                return 1;
+            buildAliasTables(pgGraph, predicateWeights, numThreads);
+        }
+    }
+    
+    std::clog << "[" << getCurrentTimestamp() << "] Graph has " << graph.numNodes() << " nodes and "
+              << graph.numEdges() << " edges\n";
     
-    if (serverMode) {
+    if (aligned) {
+        std::clog << "[" << getCurrentTimestamp() << "] Property graph has " << pgGraph.numNodes() << " nodes and "
+                  << pgGraph.numEdges() << " edges\n";
+        runAlignedRandomWalks(graph, pgGraph, alignmentFile, outputFile, numWalksPerNode, walkLength, numThreads, 
+                              bias, seed, seedGiven);
+    } else if (sharded) {
+        runShardedRandomWalks(graph, peers, rank, outputFile, numWalksPerNode, walkLength, startOptions, numThreads, 
+                              seed, format);
+    } else if (serverMode) {
         // Run in server mode
         std::clog << "[" << getCurrentTimestamp() << "] Starting in server mode on port " << port << "\n";
-        serveRandomWalks(graph, port, numWalksPerNode, walkLength, nodeSampleRate, numThreads);
+        serveRandomWalks(std::move(graph), port, numWalksPerNode, walkLength, startOptions, numThreads, bias, 
+                         predicateWeights, seed, format, metricsPort);
     } else {
-        // Generate walks in parallel and write to file
-        runParallelRandomWalks(graph, outputFile, numWalksPerNode, walkLength, nodeSampleRate, numThreads);
+        // Generate walks in parallel and write to file, tokenizing every term once up front
+        WalkTokens walkTokens;
+        if (format == kFormatTokens) {
+            BpeTokenizer tokenizer;
+            if (!tokenizer.load(tokenizerFile))
+                return 1;
+            buildWalkTokens(graph, tokenizer, numThreads, walkTokens);
+        }
+        runParallelRandomWalks(graph, outputFile, numWalksPerNode, walkLength, minWalkLength, startOptions, numThreads, 
+                               bias, seed, seedGiven, format, &walkTokens);
     }
     
+    if (gMetricsEnabled)
+        logMetricsSummary();
     return 0;
 }
\ No newline at end of file
@@ -6,6 +6,184 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+
+// Connect to the server and send one request line; returns the socket or -1
+int sendRequest(const std::string& serverHost, int serverPort, const std::string& requestStr, bool verbose) {
+    // Create socket
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        std::cerr << "Failed to create socket\n";
+        return -1;
+    }
+
+    // Set up server address
+    struct sockaddr_in servAddr;
+    memset(&servAddr, 0, sizeof(servAddr));
+    servAddr.sin_family = AF_INET;
+    servAddr.sin_port = htons(serverPort);
+
+    // Convert IPv4 address from text to binary form
+    if (inet_pton(AF_INET, serverHost.c_str(), &servAddr.sin_addr) <= 0) {
+        std::cerr << "Invalid address / Address not supported\n";
+        close(sock);
+        return -1;
+    }
+
+    // Connect to server
+    if (connect(sock, (struct sockaddr*)&servAddr, sizeof(servAddr)) < 0) {
+        std::cerr << "Connection failed\n";
+        close(sock);
+        return -1;
+    }
+
+    if (verbose)
+        std::cerr << "Connected to server at " << serverHost << ":" << serverPort << "\n";
+
+    if (verbose)
+        std::cerr << "Sending request: " << requestStr << "\n";
+
+    // Send the request
+    std::string line = requestStr + "\n";
+    send(sock, line.c_str(), line.length(), 0);
+    return sock;
+}
+
+bool readFull(int sock, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(sock, data, size);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Read a framed response (4-byte big-endian length, 1-byte type, payload) and
+// pass each payload to out as it arrives. Returns false on an error frame or
+// a connection that closes before the done frame.
+bool readFrames(int sock, std::ostream* out, size_t& payloadBytes) {
+    std::string payload;
+    payloadBytes = 0;
+    for (;;) {
+        unsigned char header[5];
+        if (!readFull(sock, reinterpret_cast<char*>(header), sizeof(header))) {
+            std::cerr << "Connection closed before the end of the stream\n";
+            return false;
+        }
+        uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) | 
+                          (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+        char type = static_cast<char>(header[4]);
+        payload.resize(length);
+        if (!readFull(sock, &payload[0], length)) {
+            std::cerr << "Connection closed in the middle of a frame\n";
+            return false;
+        }
+        if (type == 'D')
+            return true;
+        if (type == 'E') {
+            std::cerr << "Server error: " << payload << "\n";
+            return false;
+        }
+        payloadBytes += length;
+        if (out) {
+            out->write(payload.data(), payload.size());
+            out->flush();
+        }
+    }
+}
+
+// Send one STREAM_RANDOM_WALKS (or GET_DICTIONARY) request and copy the
+// streamed payload to out, or discard it when out is null
+bool streamWalks(const std::string& serverHost, int serverPort, const std::string& requestStr,
+                 std::ostream* out, size_t& payloadBytes, bool verbose) {
+    int sock = sendRequest(serverHost, serverPort, requestStr, verbose);
+    if (sock < 0)
+        return false;
+    bool ok = readFrames(sock, out, payloadBytes);
+    close(sock);
+    return ok;
+}
+
+// Send one GET_RANDOM_WALKS request and read the server's reply into response
+bool requestWalks(const std::string& serverHost, int serverPort, const std::string& requestStr,
+                  std::string& response, bool verbose) {
+    int sock = sendRequest(serverHost, serverPort, requestStr, verbose);
+    if (sock < 0)
+        return false;
+
+    // Receive response (file path) until the server closes the connection
+    response.clear();
+    char buffer[4096];
+    int bytesRead;
+    while ((bytesRead = read(sock, buffer, sizeof(buffer))) > 0) {
+        response.append(buffer, bytesRead);
+    }
+
+    // Close socket
+    close(sock);
+
+    return !response.empty();
+}
+
+// Fire `concurrency` clients at once, each sending `rounds` requests back to
+// back, and report the request latency distribution
+int runStressTest(const std::string& serverHost, int serverPort, const std::string& requestStr,
+                  bool stream, int concurrency, int rounds) {
+    std::vector<std::vector<double>> latencies(concurrency);
+    std::atomic<int> failures{0};
+    std::vector<std::thread> clients;
+
+    std::cout << "Stress test (" << requestStr << "): " << concurrency << " concurrent clients x " << rounds << " requests\n";
+    auto startTime = std::chrono::steady_clock::now();
+    for (int c = 0; c < concurrency; c++) {
+        clients.emplace_back([&, c]() {
+            std::string response;
+            for (int r = 0; r < rounds; r++) {
+                auto requestStart = std::chrono::steady_clock::now();
+                size_t payloadBytes;
+                bool ok = stream ? streamWalks(serverHost, serverPort, requestStr, nullptr, payloadBytes, false)
+                                 : requestWalks(serverHost, serverPort, requestStr, response, false) &&
+                                   response.compare(0, 6, "ERROR:") != 0;
+                if (!ok) {
+                    failures++;
+                    continue;
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - requestStart;
+                latencies[c].push_back(elapsed.count());
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    std::chrono::duration<double> totalTime = std::chrono::steady_clock::now() - startTime;
+
+    std::vector<double> all;
+    for (const auto& clientLatencies : latencies)
+        all.insert(all.end(), clientLatencies.begin(), clientLatencies.end());
+    if (all.empty()) {
+        std::cerr << "All " << failures << " requests failed\n";
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) { return all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+
+    std::cout << "Completed " << all.size() << " requests (" << failures << " failed) in "
+              << totalTime.count() << " seconds (" << all.size() / totalTime.count() << " requests/sec)\n"
+              << "Latency ms: p50 " << percentile(0.50) << ", p99 " << percentile(0.99)
+              << ", max " << all.back() << "\n";
+    return failures > 0 ? 1 : 0;
+}
 
 int main(int argc, char* argv[]) {
     // Default values
@@ -13,7 +191,20 @@ int main(int argc, char* argv[]) {
     int serverPort = 8080;
     int numWalks = 10;
     int walkLength = 15;
-    
+    std::string returnParam;
+    std::string inOutParam;
+    std::string clientName;
+    std::string seed;
+    int concurrency = 0;
+    int rounds = 1;
+    bool stream = false;
+    bool fetchDictionary = false;
+    bool fetchStats = false;
+    std::string format = "csv";
+    std::string outputFile = "-";
+    std::string updateCommand;
+    std::string updateFile;
+
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -25,68 +216,132 @@ int main(int argc, char* argv[]) {
             numWalks = std::atoi(argv[++i]);
         } else if ((arg == "-l" || arg == "--length") && i + 1 < argc) {
             walkLength = std::atoi(argv[++i]);
+        } else if (arg == "--p" && i + 1 < argc) {
+            returnParam = argv[++i];
+        } else if (arg == "--q" && i + 1 < argc) {
+            inOutParam = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = argv[++i];
+        } else if (arg == "--client" && i + 1 < argc) {
+            clientName = argv[++i];
+        } else if ((arg == "-c" || arg == "--stress") && i + 1 < argc) {
+            concurrency = std::atoi(argv[++i]);
+        } else if ((arg == "-r" || arg == "--rounds") && i + 1 < argc) {
+            rounds = std::atoi(argv[++i]);
+        } else if (arg == "-s" || arg == "--stream") {
+            stream = true;
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if ((arg == "--add-triples" || arg == "--remove-triples") && i + 1 < argc) {
+            updateCommand = arg == "--add-triples" ? "ADD_TRIPLES" : "REMOVE_TRIPLES";
+            updateFile = argv[++i];
+        } else if (arg == "--dictionary") {
+            fetchDictionary = true;
+        } else if (arg == "--stats") {
+            fetchStats = true;
+        } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            outputFile = argv[++i];
         } else {
             std::cerr << "Usage: " << argv[0] << " [options]\n"
                       << "Options:\n"
                       << "  -h, --host HOST      Server host (default: 127.0.0.1)\n"
                       << "  -p, --port PORT      Server port (default: 8080)\n"
                       << "  -w, --walks N        Number of walks per node (default: 10)\n"
-                      << "  -l, --length N       Length of each walk (default: 15)\n";
+                      << "  -l, --length N       Length of each walk (default: 15)\n"
+                      << "      --p P            node2vec return parameter (default: server's)\n"
+                      << "      --q Q            node2vec in-out parameter (default: server's)\n"
+                      << "      --client NAME    Client name; each name gets its own pass over the start nodes\n"
+                      << "      --seed N         Seed for the walks of this request (default: derived by the server)\n"
+                      << "  -c, --stress N       Stress mode: run N concurrent clients and report latency\n"
+                      << "  -r, --rounds N       Requests per client in stress mode (default: 1)\n"
+                      << "  -s, --stream         Stream the walks back over the connection instead of\n"
+                      << "                       having the server write a file\n"
+                      << "      --format FMT     Streamed walk format: csv or bin (default: csv)\n"
+                      << "      --dictionary     Download the term dictionary used by binary walks\n"
+                      << "      --stats          Print the server's metrics (Prometheus text format)\n"
+                      << "      --add-triples FILE     Merge the triples in FILE (N-Triples, on the server's\n"
+                      << "                             filesystem) into the server's graph\n"
+                      << "      --remove-triples FILE  Remove the triples in FILE from the server's graph\n"
+                      << "  -o, --output FILE    Where streamed data goes (default: - for stdout)\n";
             return 1;
         }
     }
-    
-    // Create socket
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        std::cerr << "Failed to create socket\n";
-        return 1;
-    }
-    
-    // Set up server address
-    struct sockaddr_in servAddr;
-    memset(&servAddr, 0, sizeof(servAddr));
-    servAddr.sin_family = AF_INET;
-    servAddr.sin_port = htons(serverPort);
-    
-    // Convert IPv4 address from text to binary form
-    if (inet_pton(AF_INET, serverHost.c_str(), &servAddr.sin_addr) <= 0) {
-        std::cerr << "Invalid address / Address not supported\n";
-        return 1;
+
+    if (fetchStats) {
+        std::string reply;
+        if (!requestWalks(serverHost, serverPort, "STATS", reply, true)) {
+            std::cerr << "Error receiving response from server\n";
+            return 1;
+        }
+        std::cout << reply;
+        return 0;
     }
-    
-    // Connect to server
-    if (connect(sock, (struct sockaddr*)&servAddr, sizeof(servAddr)) < 0) {
-        std::cerr << "Connection failed\n";
-        return 1;
+
+    // Graph updates are applied by the server in the background; print its reply
+    if (!updateCommand.empty()) {
+        char resolved[PATH_MAX];
+        if (realpath(updateFile.c_str(), resolved))
+            updateFile = resolved;
+        std::string reply;
+        if (!requestWalks(serverHost, serverPort, updateCommand + " " + updateFile, reply, true)) {
+            std::cerr << "Error receiving response from server\n";
+            return 1;
+        }
+        std::cout << reply << "\n";
+        return reply.compare(0, 6, "ERROR:") == 0 ? 1 : 0;
     }
-    
-    std::cout << "Connected to server at " << serverHost << ":" << serverPort << "\n";
-    
+
     // Create request with parameters
     std::stringstream requestStream;
-    requestStream << "GET_RANDOM_WALKS" << " " << numWalks << " " << walkLength;
-    std::string requestStr = requestStream.str();
-    
-    std::cout << "Sending request: " << requestStr << "\n";
-    
-    // Send the request
-    send(sock, requestStr.c_str(), requestStr.length(), 0);
-    
-    // Receive response (file path)
-    char buffer[4096];
-    int bytesRead = read(sock, buffer, sizeof(buffer) - 1);
-    if (bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        std::string filePath(buffer);
-        
-        std::cout << "Random walks have been generated and saved to: " << filePath << "\n";
+    if (fetchDictionary) {
+        requestStream << "GET_DICTIONARY";
+        stream = true;
+    } else if (stream) {
+        requestStream << "STREAM_RANDOM_WALKS" << " " << numWalks << " " << walkLength << " " << format;
     } else {
+        requestStream << "GET_RANDOM_WALKS" << " " << numWalks << " " << walkLength;
+    }
+    if (!fetchDictionary && !returnParam.empty())
+        requestStream << " p=" << returnParam;
+    if (!fetchDictionary && !inOutParam.empty())
+        requestStream << " q=" << inOutParam;
+    if (!fetchDictionary && !clientName.empty())
+        requestStream << " client=" << clientName;
+    if (!fetchDictionary && !seed.empty())
+        requestStream << " seed=" << seed;
+    std::string requestStr = requestStream.str();
+
+    if (concurrency > 0) {
+        return runStressTest(serverHost, serverPort, requestStr, stream, concurrency, rounds);
+    }
+
+    if (stream) {
+        // Streamed data goes to stdout (e.g. piped into the tokenizer) or a file; progress to stderr
+        std::ofstream file;
+        if (outputFile != "-") {
+            file.open(outputFile, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Could not open output file: " << outputFile << "\n";
+                return 1;
+            }
+        }
+        std::ostream& out = outputFile == "-" ? std::cout : file;
+        size_t payloadBytes = 0;
+        auto startTime = std::chrono::steady_clock::now();
+        if (!streamWalks(serverHost, serverPort, requestStr, &out, payloadBytes, true))
+            return 1;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cerr << "Received " << payloadBytes << " bytes in " << elapsed.count() << " seconds\n";
+        return 0;
+    }
+
+    std::string filePath;
+    if (!requestWalks(serverHost, serverPort, requestStr, filePath, true)) {
         std::cerr << "Error receiving response from server\n";
+        return 1;
     }
-    
-    // Close socket
-    close(sock);
-    
+
+    std::cout << "Random walks have been generated and saved to: " << filePath << "\n";
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,760 @@
+// Reproducible end-to-end benchmark for random_walker. It generates a
+// synthetic N-Triples graph with a power-law degree distribution (R-MAT or
+// Barabási–Albert), DBpedia-like predicate counts and IRI lengths, then runs
+// the walker binary on it once per thread count and once as a server, and
+// prints the results as JSON:
+//
+//   g++ -O2 -std=c++17 -pthread -o data_loading/walk_benchmark data_loading/walk_benchmark.cpp
+//   ./data_loading/walk_benchmark --nodes 1000000 --threads 1,2,4,8 -o bench.json
+//
+// Everything is derived from --seed, so two runs of the same build see the
+// same graph and the same walks, and their JSON can be compared directly.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <ctime>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <iomanip>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <csignal>
+#include <cerrno>
+#include <climits>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::string getCurrentTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto time = std::chrono::system_clock::to_time_t(now);
+    struct tm local;
+    localtime_r(&time, &local);
+    std::stringstream ss;
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+
+// splitmix64 finalizer; names and literals are a pure function of (seed, id)
+// so the generator needs no per-node state
+uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+struct SyntheticGraphOptions {
+    std::string model = "rmat";     // rmat or ba
+    uint64_t numNodes = 1000000;
+    int edgeFactor = 8;             // edges per node (R-MAT) or per new node (BA)
+    int numPredicates = 1500;       // about the number of DBpedia ontology properties in use
+    double literalFraction = 0.2;   // share of objects that are literals (dead ends for walks)
+    uint64_t seed = 42;
+};
+
+// DBpedia resource names are title-cased words joined by underscores, mostly
+// 10 to 40 characters; build one from syllables with a skewed length
+std::string resourceName(uint64_t seed, uint64_t id) {
+    static const char* const syllables[] = {"ka", "ber", "lin", "to", "ma", "ri", "son", "del", "an", "ge",
+                                            "vo", "ra", "mi", "chel", "ton", "ste", "war", "dorf", "ia", "no"};
+    uint64_t h = mix64(seed ^ mix64(id));
+    int words = 1 + static_cast<int>(h % 7 == 0) + static_cast<int>(h % 3 == 0);
+    std::string name;
+    for (int w = 0; w < words; w++) {
+        if (w > 0)
+            name.push_back('_');
+        h = mix64(h);
+        int parts = 2 + static_cast<int>(h % 3);
+        size_t wordStart = name.size();
+        for (int s = 0; s < parts; s++) {
+            h = mix64(h);
+            name += syllables[h % 20];
+        }
+        name[wordStart] = static_cast<char>(std::toupper(static_cast<unsigned char>(name[wordStart])));
+    }
+    // Keep names unique: the id goes in as a disambiguator, as in DBpedia's "Name_(1987_film)"
+    name += "_(" + std::to_string(id) + ")";
+    return name;
+}
+
+std::string nodeIri(const SyntheticGraphOptions& options, uint64_t id) {
+    return "<http://dbpedia.org/resource/" + resourceName(options.seed, id) + ">";
+}
+
+std::string predicateIri(const SyntheticGraphOptions& options, int predicate) {
+    std::string name = resourceName(options.seed + 1, predicate);
+    name[0] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[0])));
+    return "<http://dbpedia.org/ontology/" + name + ">";
+}
+
+// Literal objects: language-tagged labels, years and decimals, as in DBpedia
+std::string literalObject(const SyntheticGraphOptions& options, uint64_t edge) {
+    uint64_t h = mix64(options.seed ^ (edge * 0x9e3779b97f4a7c15ULL));
+    switch (h % 3) {
+        case 0:
+            return "\"" + resourceName(options.seed + 2, h >> 8) + "\"@en";
+        case 1:
+            return "\"" + std::to_string(1800 + (h >> 8) % 225) + "\"^^<http://www.w3.org/2001/XMLSchema#gYear>";
+        default:
+            return "\"" + std::to_string((h >> 8) % 1000000 / 100.0) + "\"^^<http://www.w3.org/2001/XMLSchema#double>";
+    }
+}
+
+// Predicates follow a Zipf distribution: a few (rdf:type-like) are on most
+// nodes, most are rare. The inverse CDF is tabulated once.
+class ZipfSampler {
+public:
+    ZipfSampler(int n, double exponent) : cdf(n) {
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += 1.0 / std::pow(i + 1, exponent);
+            cdf[i] = sum;
+        }
+        for (double& c : cdf)
+            c /= sum;
+    }
+
+    int sample(std::mt19937_64& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return static_cast<int>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+
+private:
+    std::vector<double> cdf;
+};
+
+// Write the synthetic graph as N-Triples; returns the number of triples or 0
+// on error
+uint64_t generateGraph(const SyntheticGraphOptions& options, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::clog << "[" << getCurrentTimestamp() << "] Could not create " << path << "\n";
+        return 0;
+    }
+    std::mt19937_64 rng(options.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    ZipfSampler predicates(options.numPredicates, 1.1);
+    uint64_t n = options.numNodes;
+
+    // R-MAT mixes node IDs with a random permutation so hubs are not all at
+    // the front of the ID space (as Graph500 does)
+    std::vector<uint64_t> permutation;
+    if (options.model == "rmat") {
+        permutation.resize(n);
+        for (uint64_t i = 0; i < n; i++)
+            permutation[i] = i;
+        std::shuffle(permutation.begin(), permutation.end(), rng);
+    }
+
+    std::string buffer;
+    uint64_t numTriples = 0;
+    auto emit = [&](uint64_t subject, uint64_t object) {
+        buffer += nodeIri(options, subject);
+        buffer.push_back(' ');
+        buffer += predicateIri(options, predicates.sample(rng));
+        buffer.push_back(' ');
+        buffer += uniform(rng) < options.literalFraction ? literalObject(options, numTriples) : nodeIri(options, object);
+        buffer += " .\n";
+        numTriples++;
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    };
+
+    if (options.model == "rmat") {
+        // Graph500 parameters (a, b, c) = (0.57, 0.19, 0.19); edges that land
+        // outside [0, n) in the padded 2^scale matrix are redrawn
+        int scale = 1;
+        while ((1ULL << scale) < n)
+            scale++;
+        uint64_t numEdges = n * options.edgeFactor;
+        while (numTriples < numEdges) {
+            uint64_t u = 0, v = 0;
+            for (int bit = 0; bit < scale; bit++) {
+                double r = uniform(rng);
+                u = (u << 1) | static_cast<uint64_t>(r >= 0.76);
+                v = (v << 1) | static_cast<uint64_t>((r >= 0.57 && r < 0.76) || r >= 0.95);
+            }
+            if (u < n && v < n)
+                emit(permutation[u], permutation[v]);
+        }
+    } else {
+        // Barabási–Albert: each new node links to edgeFactor earlier nodes
+        // chosen in proportion to their degree (via the list of edge
+        // endpoints). Edges are oriented at random so both in- and
+        // out-degrees are skewed.
+        std::vector<uint64_t> endpoints;
+        endpoints.reserve(2 * n * options.edgeFactor);
+        uint64_t m = std::max<uint64_t>(1, options.edgeFactor);
+        for (uint64_t node = 0; node < n; node++) {
+            for (uint64_t e = 0; e < m && node > 0; e++) {
+                uint64_t target = endpoints.empty() ? 0 : endpoints[rng() % endpoints.size()];
+                if (rng() & 1)
+                    emit(node, target);
+                else
+                    emit(target, node);
+                endpoints.push_back(target);
+                endpoints.push_back(node);
+            }
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    out.close();
+    if (!out) {
+        std::clog << "[" << getCurrentTimestamp() << "] Error writing " << path << "\n";
+        return 0;
+    }
+    return numTriples;
+}
+
+// Result of one walker process
+struct ProcessResult {
+    bool ok = false;
+    double wallSeconds = 0;
+    uint64_t peakRssBytes = 0;
+    std::string log;
+};
+
+// Start the walker in workDir (the server creates walks_output there) with
+// stdout and stderr going to logPath; returns the pid
+pid_t startWalker(const std::string& walker, const std::vector<std::string>& args, const std::string& workDir,
+                  const std::string& logPath) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (chdir(workDir.c_str()) < 0)
+            _exit(127);
+        int fd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(walker.c_str()));
+        for (const auto& arg : args)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(walker.c_str(), argv.data());
+        std::cerr << "Could not run " << walker << ": " << std::strerror(errno) << "\n";
+        _exit(127);
+    }
+    if (pid < 0)
+        std::clog << "[" << getCurrentTimestamp() << "] fork failed\n";
+    return pid;
+}
+
+// Reap the walker; wait4 gives the peak RSS of exactly this child
+void finishWalker(pid_t pid, const std::string& logPath, std::chrono::steady_clock::time_point start,
+                  bool expectSignal, ProcessResult& result) {
+    int status = 0;
+    struct rusage usage;
+    std::memset(&usage, 0, sizeof(usage));
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+    }
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peakRssBytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;   // ru_maxrss is in KB on Linux
+    result.ok = expectSignal ? WIFSIGNALED(status) : WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    std::ifstream log(logPath);
+    std::stringstream ss;
+    ss << log.rdbuf();
+    result.log = ss.str();
+}
+
+ProcessResult runWalker(const std::string& walker, const std::vector<std::string>& args, const std::string& workDir,
+                        const std::string& logPath) {
+    ProcessResult result;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = startWalker(walker, args, workDir, logPath);
+    if (pid > 0)
+        finishWalker(pid, logPath, start, false, result);
+    return result;
+}
+
+// Seconds from a formatDuration string ("1.5 seconds", "2 minutes 3 seconds", ...)
+double parseDuration(const std::string& text) {
+    std::istringstream in(text);
+    double value, seconds = 0;
+    std::string unit;
+    while (in >> value >> unit) {
+        if (unit.compare(0, 4, "hour") == 0)
+            seconds += value * 3600;
+        else if (unit.compare(0, 6, "minute") == 0)
+            seconds += value * 60;
+        else if (unit.compare(0, 6, "second") == 0)
+            seconds += value;
+        else
+            break;
+    }
+    return seconds;
+}
+
+// The text after `marker` on the first log line that contains it
+std::string logValue(const std::string& log, const std::string& marker) {
+    size_t pos = log.find(marker);
+    if (pos == std::string::npos)
+        return std::string();
+    pos += marker.size();
+    return log.substr(pos, log.find('\n', pos) - pos);
+}
+
+uint64_t fileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+struct ThreadRun {
+    int threads;
+    double loadSeconds = 0;
+    double walkSeconds = 0;
+    double wallSeconds = 0;
+    uint64_t walks = 0;
+    uint64_t outputBytes = 0;
+    uint64_t peakRssBytes = 0;
+};
+
+struct ServerRun {
+    int threads = 0;
+    int clients = 0;
+    size_t requests = 0;
+    size_t failed = 0;
+    double seconds = 0;
+    double p50 = 0, p99 = 0, max = 0;   // ms
+    uint64_t bytes = 0;
+    uint64_t peakRssBytes = 0;
+};
+
+// Connect to 127.0.0.1:port; -1 if nothing is listening
+int connectLocal(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+bool readFull(int sock, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(sock, data, size);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// One STREAM_RANDOM_WALKS request; the framed reply is read and discarded
+bool streamRequest(int port, const std::string& request, uint64_t& bytes) {
+    int sock = connectLocal(port);
+    if (sock < 0)
+        return false;
+    std::string line = request + "\n";
+    bool ok = send(sock, line.data(), line.size(), 0) == static_cast<ssize_t>(line.size());
+    std::vector<char> payload;
+    while (ok) {
+        unsigned char header[5];
+        if (!readFull(sock, reinterpret_cast<char*>(header), sizeof(header))) {
+            ok = false;
+            break;
+        }
+        uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) |
+                          (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+        payload.resize(length);
+        if (length > 0 && !readFull(sock, payload.data(), length)) {
+            ok = false;
+            break;
+        }
+        if (header[4] == 'D')
+            break;
+        if (header[4] == 'E')
+            ok = false;
+        bytes += length;
+    }
+    close(sock);
+    return ok;
+}
+
+// Run the walker as a server and measure request latency from `clients`
+// concurrent connections, `requests` requests in total
+ServerRun runServerBenchmark(const std::string& walker, const std::string& graphFile, const std::string& workDir,
+                             int port, int threads, int clients, size_t requests, int walksPerNode, int walkLength,
+                             uint64_t seed) {
+    ServerRun run;
+    run.threads = threads;
+    run.clients = clients;
+    std::string logPath = workDir + "/server.log";
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = startWalker(walker, {"-f", graphFile, "-S", "-p", std::to_string(port), "-t", std::to_string(threads),
+                                     "-w", std::to_string(walksPerNode), "-l", std::to_string(walkLength),
+                                     "--seed", std::to_string(seed)}, workDir, logPath);
+    if (pid <= 0)
+        return run;
+
+    // The port opens once the graph is loaded
+    bool up = false;
+    while (!up) {
+        int sock = connectLocal(port);
+        if (sock >= 0) {
+            close(sock);
+            up = true;
+        } else if (waitpid(pid, nullptr, WNOHANG) != 0) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    if (!up) {
+        std::clog << "[" << getCurrentTimestamp() << "] Server did not start; see " << logPath << "\n";
+        return run;
+    }
+
+    std::string request = "STREAM_RANDOM_WALKS " + std::to_string(walksPerNode) + " " + std::to_string(walkLength)
+                        + " csv client=benchmark";
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<size_t> nextRequest{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<uint64_t> bytes{0};
+    auto benchStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int c = 0; c < clients; c++) {
+        workers.emplace_back([&, c]() {
+            uint64_t received = 0;
+            while (nextRequest.fetch_add(1) < requests) {
+                auto t0 = std::chrono::steady_clock::now();
+                if (!streamRequest(port, request, received))
+                    failed++;
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+            }
+            bytes += received;
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - benchStart).count();
+
+    std::vector<double> all;
+    for (const auto& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    run.requests = all.size();
+    run.failed = failed;
+    run.bytes = bytes;
+    if (!all.empty()) {
+        auto percentile = [&](double p) { return all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+        run.p50 = percentile(0.50);
+        run.p99 = percentile(0.99);
+        run.max = all.back();
+    }
+
+    // The server runs until it is stopped
+    kill(pid, SIGTERM);
+    ProcessResult result;
+    finishWalker(pid, logPath, start, true, result);
+    run.peakRssBytes = result.peakRssBytes;
+    return run;
+}
+
+// JSON numbers: fixed precision, and 0 for values that are not finite
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value))
+        return "0";
+    std::ostringstream ss;
+    ss << std::setprecision(6) << value;
+    return ss.str();
+}
+
+std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        if (static_cast<unsigned char>(c) < 0x20)
+            continue;
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [options]\n"
+              << "Options:\n"
+              << "      --walker PATH       random_walker binary (default: ./data_loading/random_walker)\n"
+              << "      --model MODEL       Graph generator: rmat or ba (Barabási–Albert) (default: rmat)\n"
+              << "  -n, --nodes N           Number of nodes (default: 1000000)\n"
+              << "  -e, --edge-factor K     Edges per node (default: 8)\n"
+              << "      --predicates P      Number of distinct predicates, Zipf-distributed (default: 1500)\n"
+              << "      --literals F        Share of objects that are literals (default: 0.2)\n"
+              << "      --seed N            Seed for the graph and the walks (default: 42)\n"
+              << "      --graph FILE        Benchmark an existing N-Triples file instead of generating one\n"
+              << "  -t, --threads LIST      Comma-separated walker thread counts (default: 1,2,4,... up to the CPUs)\n"
+              << "  -w, --walks N           Walks per node (default: 2)\n"
+              << "  -l, --length N          Walk length (default: 15)\n"
+              << "      --requests N        Server requests to time; 0 skips the server benchmark (default: 200)\n"
+              << "      --clients N         Concurrent server clients (default: 8)\n"
+              << "      --port N            Port for the server benchmark (default: 18080)\n"
+              << "      --work-dir DIR      Where the graph, walks and logs go (default: a new directory in /tmp)\n"
+              << "      --keep              Keep the work directory\n"
+              << "  -o, --output FILE       JSON results (default: - for stdout)\n"
+              << "  -h, --help              Show this help message\n";
+}
+
+int main(int argc, char* argv[]) {
+    SyntheticGraphOptions options;
+    std::string walker = "./data_loading/random_walker";
+    std::string graphFile;
+    std::string workDir;
+    std::string outputFile = "-";
+    std::vector<int> threadCounts;
+    int walksPerNode = 2;
+    int walkLength = 15;
+    size_t serverRequests = 200;
+    int serverClients = 8;
+    int port = 18080;
+    bool keep = false;
+    bool ownWorkDir = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--walker" && i + 1 < argc) {
+            walker = argv[++i];
+        } else if (arg == "--model" && i + 1 < argc) {
+            options.model = argv[++i];
+            if (options.model != "rmat" && options.model != "ba") {
+                std::cerr << "Unknown model: " << options.model << "\n";
+                return 1;
+            }
+        } else if ((arg == "-n" || arg == "--nodes") && i + 1 < argc) {
+            options.numNodes = std::strtoull(argv[++i], nullptr, 10);
+        } else if ((arg == "-e" || arg == "--edge-factor") && i + 1 < argc) {
+            options.edgeFactor = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--predicates" && i + 1 < argc) {
+            options.numPredicates = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--literals" && i + 1 < argc) {
+            options.literalFraction = std::atof(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--graph" && i + 1 < argc) {
+            graphFile = argv[++i];
+        } else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            std::string count;
+            while (std::getline(list, count, ','))
+                threadCounts.push_back(std::max(1, std::atoi(count.c_str())));
+        } else if ((arg == "-w" || arg == "--walks") && i + 1 < argc) {
+            walksPerNode = std::atoi(argv[++i]);
+        } else if ((arg == "-l" || arg == "--length") && i + 1 < argc) {
+            walkLength = std::atoi(argv[++i]);
+        } else if (arg == "--requests" && i + 1 < argc) {
+            serverRequests = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--clients" && i + 1 < argc) {
+            serverClients = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        } else if (arg == "--work-dir" && i + 1 < argc) {
+            workDir = argv[++i];
+        } else if (arg == "--keep") {
+            keep = true;
+        } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (access(walker.c_str(), X_OK) != 0) {
+        std::cerr << "Walker binary not found: " << walker << " (build it or pass --walker)\n";
+        return 1;
+    }
+    int cpus = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    if (threadCounts.empty()) {
+        for (int t = 1; t < cpus; t *= 2)
+            threadCounts.push_back(t);
+        threadCounts.push_back(cpus);
+    }
+    if (workDir.empty()) {
+        char pattern[] = "/tmp/walk_benchmark.XXXXXX";
+        if (!mkdtemp(pattern)) {
+            std::cerr << "Could not create a work directory\n";
+            return 1;
+        }
+        workDir = pattern;
+        ownWorkDir = true;
+    } else if (mkdir(workDir.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "Could not create " << workDir << "\n";
+        return 1;
+    }
+    // The walker runs inside the work directory, so every path it gets is absolute
+    char resolved[PATH_MAX];
+    for (std::string* path : {&walker, &workDir, &graphFile}) {
+        if (!path->empty() && realpath(path->c_str(), resolved))
+            *path = resolved;
+    }
+
+    // Generate the graph
+    bool generated = graphFile.empty();
+    uint64_t numTriples = 0;
+    double generateSeconds = 0;
+    if (generated) {
+        graphFile = workDir + "/graph.nt";
+        std::clog << "[" << getCurrentTimestamp() << "] Generating " << options.model << " graph: " << options.numNodes
+                  << " nodes, edge factor " << options.edgeFactor << ", " << options.numPredicates << " predicates\n";
+        auto start = std::chrono::steady_clock::now();
+        numTriples = generateGraph(options, graphFile);
+        generateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (numTriples == 0)
+            return 1;
+        std::clog << "[" << getCurrentTimestamp() << "] Wrote " << numTriples << " triples (" << fileSize(graphFile)
+                  << " bytes) in " << generateSeconds << " seconds\n";
+    }
+
+    // Walks per thread count
+    std::vector<ThreadRun> runs;
+    for (int threads : threadCounts) {
+        ThreadRun run;
+        run.threads = threads;
+        std::string walksFile = workDir + "/walks.csv";
+        std::string logPath = workDir + "/walker." + std::to_string(threads) + ".log";
+        ProcessResult result = runWalker(walker, {"-f", graphFile, "-o", walksFile, "-t", std::to_string(threads),
+                                                  "-w", std::to_string(walksPerNode), "-l", std::to_string(walkLength),
+                                                  "--seed", std::to_string(options.seed)}, workDir, logPath);
+        if (!result.ok) {
+            std::clog << "[" << getCurrentTimestamp() << "] Walker failed with " << threads << " threads; see "
+                      << logPath << "\n";
+            return 1;
+        }
+        run.wallSeconds = result.wallSeconds;
+        run.peakRssBytes = result.peakRssBytes;
+        run.loadSeconds = parseDuration(logValue(result.log, "Graph loading completed in "));
+        std::istringstream generatedLine(logValue(result.log, "Random walks generation complete: Generated "));
+        std::string word;
+        generatedLine >> run.walks >> word >> word >> run.walkSeconds;
+        run.outputBytes = fileSize(walksFile);
+        std::clog << "[" << getCurrentTimestamp() << "] " << threads << " threads: " << run.walks << " walks in "
+                  << run.walkSeconds << " seconds, load " << run.loadSeconds << " seconds, peak RSS "
+                  << run.peakRssBytes / (1024 * 1024) << " MB\n";
+        runs.push_back(run);
+        unlink(walksFile.c_str());
+    }
+
+    // Server latency at the largest thread count
+    ServerRun server;
+    if (serverRequests > 0) {
+        int threads = *std::max_element(threadCounts.begin(), threadCounts.end());
+        server = runServerBenchmark(walker, graphFile, workDir, port, threads, serverClients, serverRequests,
+                                    walksPerNode, walkLength, options.seed);
+        std::clog << "[" << getCurrentTimestamp() << "] Server: " << server.requests << " requests (" << server.failed
+                  << " failed), p50 " << server.p50 << " ms, p99 " << server.p99 << " ms\n";
+    }
+
+    // Results
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"benchmark\": \"walk_benchmark\",\n"
+         << "  \"timestamp\": " << jsonString(getCurrentTimestamp()) << ",\n"
+         << "  \"cpus\": " << cpus << ",\n"
+         << "  \"graph\": {\n";
+    if (generated) {
+        json << "    \"model\": " << jsonString(options.model) << ",\n"
+             << "    \"nodes\": " << options.numNodes << ",\n"
+             << "    \"edge_factor\": " << options.edgeFactor << ",\n"
+             << "    \"predicates\": " << options.numPredicates << ",\n"
+             << "    \"literal_fraction\": " << jsonNumber(options.literalFraction) << ",\n"
+             << "    \"seed\": " << options.seed << ",\n"
+             << "    \"triples\": " << numTriples << ",\n"
+             << "    \"generate_seconds\": " << jsonNumber(generateSeconds) << ",\n";
+    } else {
+        json << "    \"file\": " << jsonString(graphFile) << ",\n";
+    }
+    json << "    \"bytes\": " << fileSize(graphFile) << "\n"
+         << "  },\n"
+         << "  \"walks_per_node\": " << walksPerNode << ",\n"
+         << "  \"walk_length\": " << walkLength << ",\n"
+         << "  \"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); i++) {
+        const ThreadRun& run = runs[i];
+        double walksPerSec = run.walkSeconds > 0 ? run.walks / run.walkSeconds : 0;
+        double baseline = runs[0].walkSeconds > 0 ? runs[0].walks / runs[0].walkSeconds / runs[0].threads : 0;
+        // Parallel efficiency against the first (normally single-threaded) run
+        double efficiency = baseline > 0 ? walksPerSec / (baseline * run.threads) : 0;
+        json << "    {\"threads\": " << run.threads
+             << ", \"load_seconds\": " << jsonNumber(run.loadSeconds)
+             << ", \"walk_seconds\": " << jsonNumber(run.walkSeconds)
+             << ", \"wall_seconds\": " << jsonNumber(run.wallSeconds)
+             << ", \"walks\": " << run.walks
+             << ", \"walks_per_sec\": " << jsonNumber(walksPerSec)
+             << ", \"efficiency\": " << jsonNumber(efficiency)
+             << ", \"output_bytes\": " << run.outputBytes
+             << ", \"bytes_per_walk\": " << jsonNumber(run.walks > 0 ? double(run.outputBytes) / run.walks : 0)
+             << ", \"peak_rss_bytes\": " << run.peakRssBytes << "}" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    json << "  ]";
+    if (serverRequests > 0) {
+        json << ",\n  \"server\": {\"threads\": " << server.threads
+             << ", \"clients\": " << server.clients
+             << ", \"requests\": " << server.requests
+             << ", \"failed\": " << server.failed
+             << ", \"requests_per_sec\": " << jsonNumber(server.seconds > 0 ? server.requests / server.seconds : 0)
+             << ", \"latency_ms\": {\"p50\": " << jsonNumber(server.p50) << ", \"p99\": " << jsonNumber(server.p99)
+             << ", \"max\": " << jsonNumber(server.max) << "}"
+             << ", \"bytes_per_request\": " << jsonNumber(server.requests > 0 ? double(server.bytes) / server.requests : 0)
+             << ", \"peak_rss_bytes\": " << server.peakRssBytes << "}";
+    }
+    json << "\n}\n";
+
+    if (outputFile == "-") {
+        std::cout << json.str();
+    } else {
+        std::ofstream out(outputFile);
+        out << json.str();
+        if (!out) {
+            std::cerr << "Could not write " << outputFile << "\n";
+            return 1;
+        }
+        std::clog << "[" << getCurrentTimestamp() << "] Results written to " << outputFile << "\n";
+    }
+
+    // A work directory we created goes away with everything in it; a given
+    // one keeps its logs
+    if (keep) {
+        std::clog << "[" << getCurrentTimestamp() << "] Kept " << workDir << "\n";
+    } else {
+        if (generated)
+            unlink(graphFile.c_str());
+        if (ownWorkDir) {
+            for (int threads : threadCounts)
+                unlink((workDir + "/walker." + std::to_string(threads) + ".log").c_str());
+            unlink((workDir + "/server.log").c_str());
+            rmdir((workDir + "/walks_output").c_str());
+            rmdir(workDir.c_str());
+        }
+    }
+    return server.failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/bash
+#SBATCH --job-name=sharded_random_walk   # Set the job name
+#SBATCH --output=sharded_random_walk.log # Set the output log file
+#SBATCH --error=sharded_random_walk.err  # Set the error log file
+#SBATCH --nodes=4                        # One shard per node
+#SBATCH --ntasks-per-node=1              # Run a single walker per node
+#SBATCH --cpus-per-task=32               # Walker threads per shard
+#SBATCH --mem=48G                        # Each shard holds only its part of the adjacency
+#SBATCH --time=24:00:00                  # Set maximum runtime to 24 hours
+#SBATCH --partition=cpu_long             # Set the partition name
+
+# Sharded random walks: the graph is hash-partitioned by subject across the
+# tasks and walks are forwarded between them over TCP. Each rank writes its
+# walks to ${OUT_FILE}.<rank>.
+#
+# Under SLURM, one rank runs per task. Outside SLURM, the script starts
+# LOCAL_RANKS walker processes on this machine, which is handy for testing:
+#   LOCAL_RANKS=4 ./slurm_scripts/sharded_random_walk.sh
+
+WALKER=${WALKER:-./data_loading/random_walker}
+GRAPH_FILE=${GRAPH_FILE:-data/dbpedia_ml.nt}
+OUT_FILE=${OUT_FILE:-$PWD/walks.csv}
+BASE_PORT=${BASE_PORT:-7000}
+WALKER_ARGS=${WALKER_ARGS:-"-w 10 -l 15 --seed 42"}
+
+if [[ -n "${SLURM_JOB_NODELIST}" ]]; then
+    # One peer per task, in task order
+    PEERS=""
+    for host in $(scontrol show hostnames "${SLURM_JOB_NODELIST}"); do
+        addr=$(getent ahostsv4 "${host}" | awk 'NR==1 {print $1}')
+        PEERS+="${PEERS:+,}${addr}:${BASE_PORT}"
+    done
+    echo "Starting ${SLURM_NTASKS} shards at $(date): ${PEERS}"
+    srun bash -c "${WALKER} -f ${GRAPH_FILE} -o ${OUT_FILE} -t ${SLURM_CPUS_PER_TASK} ${WALKER_ARGS} \
+                  --peers ${PEERS} --rank \${SLURM_PROCID}"
+else
+    LOCAL_RANKS=${LOCAL_RANKS:-2}
+    PEERS=""
+    for (( rank=0; rank < LOCAL_RANKS; rank++ )); do
+        PEERS+="${PEERS:+,}127.0.0.1:$(( BASE_PORT + rank ))"
+    done
+    echo "Starting ${LOCAL_RANKS} local shards at $(date): ${PEERS}"
+    for (( rank=0; rank < LOCAL_RANKS; rank++ )); do
+        ${WALKER} -f ${GRAPH_FILE} -o ${OUT_FILE} ${WALKER_ARGS} --peers ${PEERS} --rank ${rank} \
+            2> "sharded_random_walk.${rank}.err" &
+    done
+    wait
+fi
+
+echo "Finished sharded random walks at $(date); shards are ${OUT_FILE}.*"
@@ -0,0 +1,66 @@
+#!/bin/bash
+# Regression checks for property graph loading: walks over data/pg with one
+# relationship given a property. With --pg-nodes the relationship must pass
+# through a node that carries the property, the other relationships must stay
+# direct hops, and without --pg-nodes the property must not change the
+# output at all. Exits non-zero if any check fails.
+#   ./test_property_graph.sh
+#   WALKER=/path/to/random_walker ./test_property_graph.sh
+
+WALKER=${WALKER:-./data_loading/random_walker}
+PG_DIR=${PG_DIR:-data/pg}
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+# Einstein's doctoral advisor relationship gets a start year
+sed 's/^1,3,DOCTORAL_ADVISOR,"{}"$/1,3,DOCTORAL_ADVISOR,"{""since"":1902}"/' "${PG_DIR}/edges.csv" \
+    > "${WORK_DIR}/edges.csv"
+if cmp -s "${PG_DIR}/edges.csv" "${WORK_DIR}/edges.csv"; then
+    echo "FAIL the 1,3,DOCTORAL_ADVISOR edge of ${PG_DIR}/edges.csv was not found"
+    exit 1
+fi
+
+# walks NAME EDGES ARGS...: write the walks of one run to WORK_DIR/NAME
+function walks() {
+    local name=$1 edges=$2
+    shift 2
+    ${WALKER} --pg-edges "${edges}" -o "${WORK_DIR}/${name}" -w 20 -l 6 --seed 42 -t 2 "$@" \
+        2> "${WORK_DIR}/${name}.log"
+}
+
+failed=0
+# check NAME FILE PATTERN: some walk in FILE must contain the fixed string PATTERN (or none, for !PATTERN)
+function check() {
+    local found=0
+    grep -qF -- "${3#!}" "$2" && found=1
+    if [[ "$3" == !* ]]; then
+        (( found = !found ))
+    fi
+    if (( found )); then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: '$3' in $(basename "$2")"
+        failed=1
+    fi
+}
+
+walks plain "${PG_DIR}/edges.csv" --pg-nodes "${PG_DIR}/nodes.csv"
+walks property "${WORK_DIR}/edges.csv" --pg-nodes "${PG_DIR}/nodes.csv"
+walks plain-edges "${PG_DIR}/edges.csv"
+walks property-edges "${WORK_DIR}/edges.csv"
+
+check "relationship without properties is a direct hop" "${WORK_DIR}/plain" "pg:1,DOCTORAL_ADVISOR,pg:3"
+check "no reified node without properties" "${WORK_DIR}/plain" "!pg:1-DOCTORAL_ADVISOR-3"
+check "relationship with properties passes through its node" "${WORK_DIR}/property" \
+      "pg:1,DOCTORAL_ADVISOR,pg:1-DOCTORAL_ADVISOR-3"
+check "reified node leads on to the end node" "${WORK_DIR}/property" "pg:1-DOCTORAL_ADVISOR-3,DOCTORAL_ADVISOR,pg:3"
+check "reified node carries the property" "${WORK_DIR}/property" "pg:1-DOCTORAL_ADVISOR-3,since,1902"
+check "other relationships stay direct hops" "${WORK_DIR}/property" "pg:1,EMPLOYER,pg:4"
+if cmp -s "${WORK_DIR}/plain-edges" "${WORK_DIR}/property-edges"; then
+    echo "ok   without --pg-nodes edge properties do not change the walks"
+else
+    echo "FAIL without --pg-nodes edge properties changed the walks"
+    failed=1
+fi
+
+exit ${failed}
@@ -0,0 +1,105 @@
+#!/bin/bash
+# Regression check for seeded walks: with --seed, the walker's output must be
+# the same byte for byte whatever the number of threads. Every configuration
+# below is run with each thread count in THREADS and the outputs are compared
+# with cmp against the first one. A sharded run over RANKS local processes
+# must then write the same walks as a single process, in any order across
+# the shard files. Exits non-zero if any check fails.
+#   ./test_walk_determinism.sh
+#   THREADS="1 2 16" GRAPH_FILE=data/dbpedia_ml.nt ./test_walk_determinism.sh
+#   RANKS=4 BASE_PORT=9000 ./test_walk_determinism.sh
+
+WALKER=${WALKER:-./data_loading/random_walker}
+GRAPH_FILE=${GRAPH_FILE:-data/rdf/random_triples.ttl}
+THREADS=${THREADS:-"1 3 8"}
+RANKS=${RANKS:-3}
+BASE_PORT=${BASE_PORT:-7700}
+OUT_DIR=$(mktemp -d)
+trap 'rm -rf "${OUT_DIR}"' EXIT
+
+# Name and walker arguments of each configuration
+CONFIGS=(
+    "csv|-w 10 -l 15 --seed 42"
+    "min-length|-w 10 -l 15 --min-length 8 --seed 42"
+    "node2vec|-w 5 -l 10 --p 0.5 --q 2 --seed 42"
+    "sampled|-w 5 -l 10 -s 0.5 --seed 7"
+    "bin|-w 10 -l 15 --format bin --seed 42"
+)
+
+# Configurations for the sharded check. Not -s: each rank samples its own
+# start nodes, so a sampled sharded run starts from other nodes.
+SHARD_CONFIGS=(
+    "csv|-w 10 -l 15 --seed 42"
+    "bin|-w 10 -l 15 --format bin --seed 42"
+)
+
+failed=0
+for config in "${CONFIGS[@]}"; do
+    name=${config%%|*}
+    args=${config#*|}
+    reference=""
+    same=1
+    for threads in ${THREADS}; do
+        out="${OUT_DIR}/${name}.t${threads}"
+        if ! ${WALKER} -f "${GRAPH_FILE}" -o "${out}" -t ${threads} ${args} 2> "${out}.log"; then
+            echo "FAIL ${name}: walker exited with an error at -t ${threads} (see below)"
+            cat "${out}.log"
+            exit 1
+        fi
+        if [[ -z "${reference}" ]]; then
+            reference=${out}
+        elif ! cmp -s "${reference}" "${out}" || 
+             { [[ -f "${reference}.dict" ]] && ! cmp -s "${reference}.dict" "${out}.dict"; }; then
+            echo "FAIL ${name}: -t ${threads} differs from -t ${THREADS%% *}"
+            same=0
+            failed=1
+        fi
+    done
+    (( same )) && echo "ok   ${name}: $(wc -c < "${reference}") bytes, identical for -t ${THREADS}"
+done
+
+# Walks of a file as sorted CSV lines, decoding binary walk files first
+function sorted_walks() {
+    if [[ -f "$1.dict" ]]; then
+        ${WALKER} --decode "$1" -o - 2> /dev/null | sort
+    else
+        sort "$1"
+    fi
+}
+
+peers=""
+for (( rank = 0; rank < RANKS; rank++ )); do
+    peers+="${peers:+,}127.0.0.1:$(( BASE_PORT + rank ))"
+done
+for config in "${SHARD_CONFIGS[@]}"; do
+    name=${config%%|*}
+    args=${config#*|}
+    single="${OUT_DIR}/${name}.single"
+    sharded="${OUT_DIR}/${name}.sharded"
+    ${WALKER} -f "${GRAPH_FILE}" -o "${single}" -t 2 ${args} 2> "${single}.log"
+    pids=()
+    for (( rank = 0; rank < RANKS; rank++ )); do
+        ${WALKER} -f "${GRAPH_FILE}" -o "${sharded}" -t 2 ${args} --peers "${peers}" --rank ${rank} \
+            2> "${sharded}.${rank}.log" &
+        pids+=($!)
+    done
+    status=0
+    for pid in "${pids[@]}"; do
+        wait ${pid} || status=1
+    done
+    if (( status )); then
+        echo "FAIL ${name}: a shard exited with an error (see below)"
+        cat "${sharded}".*.log
+        failed=1
+        continue
+    fi
+    if cmp -s <(sorted_walks "${single}") \
+              <(for (( rank = 0; rank < RANKS; rank++ )); do sorted_walks "${sharded}.${rank}"; done | sort); then
+        echo "ok   ${name}: ${RANKS} shards write the walks of one process"
+    else
+        echo "FAIL ${name}: ${RANKS} shards differ from one process"
+        failed=1
+    fi
+done
+
+exit ${failed}
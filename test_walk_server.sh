@@ -0,0 +1,78 @@
+#!/bin/bash
+# Regression checks for the walk server's request parsing: starts a server on
+# a two-node cycle and checks its replies to well-formed and malformed
+# GET_RANDOM_WALKS requests. Exits non-zero if any check fails.
+#   ./test_walk_server.sh
+#   PORT=9000 WALKER=/path/to/random_walker ./test_walk_server.sh
+
+WALKER=$(realpath "${WALKER:-./data_loading/random_walker}")
+PORT=${PORT:-7391}
+WORK_DIR=$(mktemp -d)
+trap 'kill ${SERVER_PID} 2>/dev/null; rm -rf "${WORK_DIR}"' EXIT
+
+# a -> b -> a: every walk can go on for as long as it is asked to
+printf '<a> <p> <b> .\n<b> <p> <a> .\n' > "${WORK_DIR}/cycle.nt"
+
+# One request per connection; prints the server's reply
+function request() {
+    exec 3<>/dev/tcp/127.0.0.1/${PORT} || return 1
+    printf '%s\n' "$1" >&3
+    timeout 30 cat <&3
+    exec 3<&-
+}
+
+failed=0
+# check NAME REQUEST PATTERN: the reply must match the extended regex PATTERN
+function check() {
+    local reply
+    reply=$(request "$2" 2>&1)
+    if [[ "${reply}" =~ $3 ]]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: '$2' got '${reply:0:200}'"
+        failed=1
+    fi
+}
+
+# check_walks NAME REQUEST LINES: the reply must name a walk file with LINES walks
+function check_walks() {
+    local reply
+    reply=$(request "$2" 2>&1)
+    if [[ -f "${reply}" && $(wc -l < "${reply}") -eq $3 ]]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: '$2' got '${reply:0:200}'"
+        failed=1
+    fi
+}
+
+# Command-line values are checked the same way as request values
+if ${WALKER} -f "${WORK_DIR}/cycle.nt" -o "${WORK_DIR}/walks.csv" --p 1e-310 2> /dev/null; then
+    echo "FAIL --p 1e-310 was accepted"
+    failed=1
+else
+    echo "ok   --p 1e-310 is rejected"
+fi
+
+# The server runs on a small stack, so nothing on the request path may use
+# stack in proportion to the walk length
+cd "${WORK_DIR}"
+(ulimit -s 256; exec ${WALKER} -f cycle.nt -S -p ${PORT} -t 1 --seed 1 2> server.log) &
+SERVER_PID=$!
+for (( i = 0; i < 100; i++ )); do
+    (exec 3<>/dev/tcp/127.0.0.1/${PORT}) 2> /dev/null && break
+    sleep 0.1
+done
+
+check_walks "plain request" "GET_RANDOM_WALKS 3 4" 2
+check_walks "node2vec request" "GET_RANDOM_WALKS 3 4 p=0.5 q=2" 2
+check_walks "longest walk on a cycle" "GET_RANDOM_WALKS 2 65536" 2
+check_walks "extreme p still terminates" "GET_RANDOM_WALKS 1 6 p=1e12" 2
+check "denormal p is rejected" "GET_RANDOM_WALKS 1 4 p=1e-310" "^ERROR: p "
+check "denormal q is rejected" "GET_RANDOM_WALKS 1 4 q=4e-320" "^ERROR: q "
+check "zero p is rejected" "GET_RANDOM_WALKS 1 4 p=0" "^ERROR: p "
+check "negative walk count is rejected" "GET_RANDOM_WALKS -1 41" "^ERROR: numWalks"
+check "zero walk length is rejected" "GET_RANDOM_WALKS 1 0" "^ERROR: walkLength"
+check_walks "server still answers after rejections" "GET_RANDOM_WALKS 1 4" 2
+
+exit ${failed}